@@ -0,0 +1,77 @@
+
+#include "asyncreply.h"
+
+cc::AsyncReply::AsyncReply(PortableServer::POA_ptr poa, Done done)
+              : _poa{PortableServer::POA::_duplicate(poa)}
+              , _done{std::move(done)}
+              , _active{false}
+{
+}
+
+CorbaCommModule::AMI_ProviderHandler_ptr cc::AsyncReply::activate()
+{
+    _id     = _poa->activate_object(this);
+    _active = true;
+    _remove_ref();
+    return _this();
+}
+
+void cc::AsyncReply::fail(bool gone)
+{
+    complete(CmdStatus::failed, gone, "");
+}
+
+void cc::AsyncReply::execCmdById(const char* ami_return_val)
+{
+    complete(CmdStatus::done, false, ami_return_val);
+}
+
+// like a blocking call, a provider which sheds the request or times
+// out is busy or slow, not gone
+//
+void cc::AsyncReply::execCmdById_excep(Messaging::ExceptionHolder* 
+                                       excep_holder)
+{
+    try {
+        excep_holder->raise_exception();
+    }
+    catch (CORBA::NO_RESOURCES&) {
+        complete(CmdStatus::overloaded, false, "");
+    }
+    catch (CORBA::TRANSIENT& ex) {
+        complete(CmdStatus::failed, 
+                 ex.minor() != omni::TRANSIENT_CallTimedout, "");
+    }
+    catch (...) {
+        complete(CmdStatus::failed, true, "");
+    }
+}
+
+// the servant may be deleted by 'deactivate_object()', nothing of it
+// is touched after that
+//
+void cc::AsyncReply::complete(CmdStatus status, bool gone, 
+                              const char* result)
+{
+    try {
+        _done(status, gone, result);
+    }
+    catch (...) {
+        // a requester's callback must never take an ORB thread down
+        //
+    }
+
+    // it's still the caller's if it was never activated
+    //
+    if (!_active) {
+        _remove_ref();
+        return;
+    }
+    PortableServer::POA_var      poa = _poa._retn();
+    PortableServer::ObjectId_var id  = _id._retn();
+    try {
+        poa->deactivate_object(id.in());
+    }
+    catch (...) {
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef _ASYNCREPLY_H
+#define _ASYNCREPLY_H
+#include <functional>
+#include "corbaComm.hh"
+#include "corbaComm.h"
+
+namespace cc {
+
+// the reply handler of one 'sendc_execCmdById()' (CORBA AMI), so a
+// request in flight holds no thread; the ORB calls the handler with
+// the reply, or the exception, on one of its own threads
+//
+// it's activated for its request and deactivated once 'done' is
+// called, exactly once; 'gone' is true if the provider can't be
+// reached (it's neither busy nor slow)
+//
+class AsyncReply: public POA_CorbaCommModule::AMI_ProviderHandler
+{
+public:
+    typedef std::function<void(CmdStatus, bool gone, 
+                               const char* result)>  Done;
+
+    AsyncReply(PortableServer::POA_ptr poa, Done done);
+    virtual ~AsyncReply() { }
+
+    // the handler's reference, for 'sendc_execCmdById()'
+    // the POA owns the servant from now on
+    //
+    CorbaCommModule::AMI_ProviderHandler_ptr activate();
+
+    // the request can't be sent, 'done' is called now
+    //
+    void fail(bool gone);
+
+    // interface method(s)
+    //
+    void execCmdById(const char* ami_return_val);
+    void execCmdById_excep(Messaging::ExceptionHolder* excep_holder);
+
+    // the handler is passed to 'sendc_execCmdById()' only,
+    // the other replies never come
+    //
+    void execCmd(const char*) { }
+    void execCmd_excep(Messaging::ExceptionHolder*) { }
+    void execBatch(const CorbaCommModule::ResultSeq&) { }
+    void execBatch_excep(Messaging::ExceptionHolder*) { }
+    void execBinCmd(const CorbaCommModule::Octets&) { }
+    void execBinCmd_excep(Messaging::ExceptionHolder*) { }
+    void sharedMemory(const char*) { }
+    void sharedMemory_excep(Messaging::ExceptionHolder*) { }
+    void waitProcessed(CORBA::ULongLong, CORBA::ULongLong) { }
+    void waitProcessed_excep(Messaging::ExceptionHolder*) { }
+
+    // Big-5 rules
+    AsyncReply() = delete;
+    AsyncReply(const AsyncReply&) = delete;
+    AsyncReply(AsyncReply&&) = delete;
+    AsyncReply& operator=(const AsyncReply&) = delete;
+    AsyncReply& operator=(AsyncReply&&) = delete;
+
+private:
+    void complete(CmdStatus, bool gone, const char* result);
+
+    PortableServer::POA_var      _poa;
+    PortableServer::ObjectId_var _id;
+    Done                         _done;
+    bool                         _active;
+};
+
+};  // namespace cc
+
+#endif
+
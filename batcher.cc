@@ -0,0 +1,98 @@
+
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include "batcher.h"
+
+cc::EventBatcher::EventBatcher(unsigned batchSize, unsigned delayMs,
+                               cc::EventBatcher::Sender send)
+                : _batchSize(batchSize > 0 ? batchSize : 1)
+                , _delay(delayMs)
+                , _send(std::move(send))
+                , _pending(_batchSize)
+                , _stopping{false}
+{
+    _flusher = std::thread([this]() { run(); });
+}
+
+cc::EventBatcher::~EventBatcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _cv.notify_all();
+    _flusher.join();
+    flush();
+}
+
+bool cc::EventBatcher::push(const CosN::StructuredEvent& event)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    CORBA::ULong n = _pending.length();
+    _pending.length(n + 1);
+    _pending[n] = event;
+
+    if (n + 1 >= _batchSize)
+        return sendPending(lock);
+
+    // the first event of a batch starts its delay
+    //
+    if (0 == n) {
+        _oldest = std::chrono::steady_clock::now();
+        _cv.notify_one();
+    }
+    return true;
+}
+
+bool cc::EventBatcher::flush()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return sendPending(lock);
+}
+
+// must be called with '_mutex' locked, it's unlocked while sending
+// a batch which is being sent by another thread is waited for,
+// so everything pushed before is sent when this returns
+//
+bool cc::EventBatcher::sendPending(std::unique_lock<std::mutex>& lock)
+{
+    // hand the filled buffer to 'batch' instead of copying the events
+    //
+    CORBA::ULong length  = _pending.length();
+    CORBA::ULong maximum = _pending.maximum();
+    CosN::EventBatch batch(maximum, length, _pending.get_buffer(true), true);
+    _pending.replace(_batchSize, 0,
+                     CosN::EventBatch::allocbuf(_batchSize), true);
+
+    // take the send turn before the next batch can be filled
+    //
+    std::unique_lock<std::mutex> turn(_sendMutex);
+    lock.unlock();
+    bool sent = 0 == length || _send(batch);
+    turn.unlock();
+    lock.lock();
+    return sent;
+}
+
+void cc::EventBatcher::run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _cv.wait(lock, [this]() {
+            return _stopping || _pending.length() > 0;
+        });
+        if (_stopping)
+            return;
+
+        // the batch may be sent by a publisher while waiting,
+        // the next one has its own delay
+        //
+        auto due = _oldest + _delay;
+        if (std::chrono::steady_clock::now() < due) {
+            _cv.wait_until(lock, due);
+            continue;
+        }
+        sendPending(lock);
+    }
+}
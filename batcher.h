@@ -0,0 +1,61 @@
+#ifndef _BATCHER_H
+#define _BATCHER_H
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+#include "cos.h"
+
+namespace cc {
+
+// collects published events into an 'EventBatch' and sends it when
+// it holds 'batchSize' events or its oldest event is 'delayMs' old,
+// whichever comes first; batches are sent in the order they're filled
+//
+// a full batch is sent by the publisher which fills it, so a fast
+// publisher is slowed down to the channel's pace instead of queueing
+// without a bound; the rest are sent by the batcher's own thread
+//
+class EventBatcher {
+public:
+    typedef std::function<bool(const CosN::EventBatch&)> Sender;
+
+    EventBatcher(unsigned batchSize, unsigned delayMs, Sender send);
+    ~EventBatcher();                // sends what is left
+
+    // the event is copied, the caller may reuse it
+    // false if a full batch is sent and failed
+    //
+    bool push(const CosN::StructuredEvent&);
+
+    // sends the pending events now, false if they can't be sent
+    //
+    bool flush();
+
+    // Big-5 rules
+    EventBatcher() = delete;
+    EventBatcher(const EventBatcher&) = delete;
+    EventBatcher(EventBatcher&&) = delete;
+    EventBatcher& operator=(const EventBatcher&) = delete;
+    EventBatcher& operator=(EventBatcher&&) = delete;
+
+private:
+    bool sendPending(std::unique_lock<std::mutex>&);
+    void run();
+
+    const unsigned                        _batchSize;
+    const std::chrono::milliseconds       _delay;
+    Sender                                _send;
+    CosN::EventBatch                      _pending;
+    std::chrono::steady_clock::time_point _oldest;
+    std::mutex                            _mutex;
+    std::mutex                            _sendMutex;   // keeps the order
+    std::condition_variable               _cv;
+    bool                                  _stopping;
+    std::thread                           _flusher;
+};
+
+};  // namespace cc
+
+#endif
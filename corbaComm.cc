@@ -15,13 +15,15 @@ cc::CorbaComm* cc::CorbaComm::connect(const char* hostId,
                                       cc::Commands offerCommands,
                                       cc::Commands wantCommands,
                                       int argc, 
-                                      char* argv[]) 
+                                      char* argv[],
+                                      const cc::Options& options) 
 {
     if (nullptr == _ccserver) {
         cc::CorbaComm::_ccserver = new cc::CorbaComm(hostId,
                                                      offerCommands,
                                                      wantCommands,
-                                                     argc, argv);
+                                                     argc, argv,
+                                                     options);
     }
     return cc::CorbaComm::_ccserver;
 }
@@ -32,39 +34,176 @@ cc::SID cc::CorbaComm::onEvent(const char* topic,
     return cc::CorbaComm::_impl->onEvent(topic, callback);
 }
 
+cc::SID cc::CorbaComm::onBinEvent(const char* topic,
+                                  cc::BinaryEventCallback_t callback)
+{
+    return cc::CorbaComm::_impl->onBinEvent(topic, callback);
+}
+
+cc::SID cc::CorbaComm::onEventBatch(const char* topic,
+                                    cc::EventBatchCallback_t callback)
+{
+    return cc::CorbaComm::_impl->onEventBatch(topic, callback);
+}
+
+cc::DispatchStats cc::CorbaComm::dispatchStats() const
+{
+    return cc::CorbaComm::_impl->dispatchStats();
+}
+
 void cc::CorbaComm::detachEvent(const cc::SID& sid)
 {
     cc::CorbaComm::_impl->detachEvent(sid);
 }
 
+bool cc::CorbaComm::pollTopic(const char* topic)
+{
+    return cc::CorbaComm::_impl->pollTopic(topic);
+}
+
+void cc::CorbaComm::unpollTopic(const char* topic)
+{
+    cc::CorbaComm::_impl->unpollTopic(topic);
+}
+
+cc::PolledEvents cc::CorbaComm::pollEvents(size_t maxBatch, unsigned timeoutMs)
+{
+    return cc::CorbaComm::_impl->pollEvents(maxBatch, timeoutMs);
+}
+
 bool cc::CorbaComm::pushEvent(const char* topic, 
                               const char* param)
 {
     return cc::CorbaComm::_impl->pushEvent(topic, param);
 }
 
+bool cc::CorbaComm::pushBinEvent(const char* topic, 
+                                 const void* data, size_t length)
+{
+    return cc::CorbaComm::_impl->pushBinEvent(topic, data, length);
+}
+
+bool cc::CorbaComm::flushEvents()
+{
+    return cc::CorbaComm::_impl->flushEvents();
+}
+
+cc::PublishStats cc::CorbaComm::publishStats() const
+{
+    return cc::CorbaComm::_impl->publishStats();
+}
+
+bool cc::CorbaComm::setChannelQoS(const cc::ChannelQoS& qos)
+{
+    return cc::CorbaComm::_impl->setChannelQoS(qos);
+}
+
+void cc::CorbaComm::setTopicQoS(const char* topic, const cc::TopicQoS& qos)
+{
+    cc::CorbaComm::_impl->setTopicQoS(topic, qos);
+}
+
 std::string cc::CorbaComm::execCmd(const char* cmd, const char* param)
 {
     return cc::CorbaComm::_impl->execCmd(cmd, param);
 }
 
+cc::CmdId cc::CorbaComm::internCmd(const char* cmd)
+{
+    return cc::CorbaComm::_impl->internCmd(cmd);
+}
+
+std::string cc::CorbaComm::execCmdById(cc::CmdId id, const char* param)
+{
+    return cc::CorbaComm::_impl->execCmdById(id, param);
+}
+
+bool cc::CorbaComm::postCmd(const char* cmd, const char* param)
+{
+    return cc::CorbaComm::_impl->postCmd(cmd, param);
+}
+
+bool cc::CorbaComm::flushCmds(unsigned timeoutMs)
+{
+    return cc::CorbaComm::_impl->flushCmds(timeoutMs);
+}
+
+void cc::CorbaComm::cacheCmd(const char* cmd, unsigned ttlMs)
+{
+    cc::CorbaComm::_impl->cacheCmd(cmd, ttlMs);
+}
+
+cc::CacheStats cc::CorbaComm::cacheStats() const
+{
+    return cc::CorbaComm::_impl->cacheStats();
+}
+
+void cc::CorbaComm::setCallPolicy(const char* cmd, 
+                                  const cc::CallPolicy& policy)
+{
+    cc::CorbaComm::_impl->setCallPolicy(cmd, policy);
+}
+
+cc::HedgeStats cc::CorbaComm::hedgeStats() const
+{
+    return cc::CorbaComm::_impl->hedgeStats();
+}
+
+std::string cc::CorbaComm::execBinCmd(const char* cmd, 
+                                      const void* data, size_t length)
+{
+    return cc::CorbaComm::_impl->execBinCmd(cmd, data, length);
+}
+
+cc::CmdStatus cc::CorbaComm::execBinCmd(const char* cmd, 
+                                        const void* data, size_t length,
+                                        std::string& result)
+{
+    return cc::CorbaComm::_impl->execBinCmd(cmd, data, length, result);
+}
+
+std::future<cc::CmdResult> cc::CorbaComm::execCmdAsync(const char* cmd, 
+                                                       const char* param)
+{
+    return cc::CorbaComm::_impl->execCmdAsync(cmd, param);
+}
+
+void cc::CorbaComm::execCmdAsync(const char* cmd, const char* param,
+                                 cc::CompletionCallback_t callback)
+{
+    cc::CorbaComm::_impl->execCmdAsync(cmd, param, callback);
+}
+
+cc::Results cc::CorbaComm::execBatch(const cc::CmdRequests& requests)
+{
+    return cc::CorbaComm::_impl->execBatch(requests);
+}
+
 void cc::CorbaComm::onCmd(const char* cmd,
                           cc::CommandCallback_t cmdCallback)
 {
     cc::CorbaComm::_impl->onCmd(cmd, cmdCallback);
 }
 
+void cc::CorbaComm::onBinCmd(const char* cmd,
+                             cc::BinaryCommandCallback_t cmdCallback)
+{
+    cc::CorbaComm::_impl->onBinCmd(cmd, cmdCallback);
+}
+
 //private
 cc::CorbaComm::CorbaComm(const char* hostId,
                          cc::Commands offerCommands,
                          cc::Commands wantCommands,
-                         int argc, char* argv[]) 
+                         int argc, char* argv[],
+                         const cc::Options& options) 
 {
     cc::CorbaComm::_impl = 
     new cc::CorbaCommImpl(hostId,
                           offerCommands,
                           wantCommands,
-                          argc, argv);
+                          argc, argv,
+                          options);
 }
 
 
@@ -1,8 +1,12 @@
 #ifndef _CORBA_COMM_H
 #define _CORBA_COMM_H
 
+#include <map>
 #include <string>
+#include <cstdint>
 #include <vector>
+#include <future>
+#include <utility>
 
 namespace cc {
 
@@ -20,21 +24,318 @@ typedef std::string (*CommandCallback_t)(const std::string& cmd,
 typedef void (*EventCallback_t)(const std::string& topic, 
                                 const std::string& param);
 
+// binary-safe variants of the above two callbacks
+// 'data' may contain NULs, it is only valid during the callback
+//
+typedef std::string (*BinaryCommandCallback_t)(const std::string& cmd,
+                                               const char* data,
+                                               size_t      length);
+typedef void (*BinaryEventCallback_t)(const std::string& topic,
+                                      const char* data,
+                                      size_t      length);
+
+// for subscribers of whole batches, please refer to onEventBatch()
+// each (data, length) is an event of the batch, in order, 
+// only valid during the callback
+//
+typedef std::vector<std::pair<const char*, size_t>>  EventViews;
+typedef void (*EventBatchCallback_t)(const std::string& topic,
+                                     const EventViews&  events);
+
 // for event publisher, no need to connect a new type (both share the same cmds)
 //
 typedef std::vector<std::string>   Commands;
 
+// for execBatch(), each request is a (cmd, param) pair
+// results are in the same order as requests
+//
+typedef std::pair<std::string, std::string> CmdRequest;
+typedef std::vector<CmdRequest>             CmdRequests;
+typedef std::vector<std::string>            Results;
+
 // for onEvent() and detachEvent() methods
 // an SID (Subscription ID, is an ID returned by onEvent()
 // if the host would like to unscribe an event, 
 // calls detachEvent() with this ID
 //
 // if the hosts call onEvent with the 
-// same 'event' and 'callback' more than once
-// an empty SID return
+// same 'event' and 'callback' more than once, or the notification
+// server's filter can't be changed, an empty SID return
 //
 typedef std::string  SID;
 
+// for internCmd() and execCmdById()
+// a command name interned once, it's cheaper to invoke by id than by name
+// a negative id is never valid
+//
+typedef int  CmdId;
+
+// what became of a command, for execBinCmd() with a status and
+// execCmdAsync()
+//
+enum class CmdStatus {
+    done,
+    unrouted,       // no provider offers the command
+    overloaded,     // the provider shed the request, it wasn't run
+    failed          // the provider can't be reached, or timed out
+};
+
+// for execCmdAsync(), what became of the command and, if it's done,
+// its result
+//
+struct CmdResult {
+    CmdStatus   status;
+    std::string result;
+};
+
+// for execCmdAsync() only
+// when the command provider responds (or fails), 'CorbaComm' invokes
+// requester's callback on an ORB thread; a request which isn't sent
+// (not routed, co-located, cached or refused) is completed on the
+// caller's thread
+//
+typedef void (*CompletionCallback_t)(const std::string& cmd,
+                                     const CmdResult&   result);
+
+// for Options, command provider's per-command dispatch limits
+//
+struct CmdLimits {
+    unsigned maxConcurrency = 0;    // 0: no limit but 'providerThreads'
+    unsigned queueSize      = 64;   // 0: unbounded
+};
+
+// for Options, how a command offered by many providers (replicas)
+// is spread across them
+//
+enum class BalancePolicy {
+    roundRobin,
+    leastOutstanding,       // the provider with the fewest calls in flight
+    powerOfTwo              // the better of two random picks, by latency
+};
+
+// for Options, ZIOP (zlib) compression of requests and responses
+// a message smaller than 'minSize' bytes is sent uncompressed
+//
+struct CompressionPolicy {
+    bool     enabled = true;
+    unsigned minSize = 1024;
+    unsigned level   = 6;       // 1: fastest .. 9: smallest
+};
+
+// for cacheStats(), the client-side result cache's counters
+//
+struct CacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    size_t   entries;
+};
+
+// for dispatchStats(), subscriber's event delivery by 'eventThreads'
+// latencies are from an event's arrival to its callbacks
+//
+struct DispatchStats {
+    uint64_t queued;            // events waiting now
+    uint64_t delivered;
+    uint64_t latencyUs;         // moving average
+    uint64_t maxLatencyUs;
+};
+
+// for Options, what an asynchronous publisher does with an event of
+// a topic when its queue is full; each policy has a queue of its own,
+// so only events of topics of the same policy are ever dropped
+//
+enum class OverflowPolicy {
+    block,                  // the publisher waits for room, never drops
+    dropOldest,             // the oldest queued 'dropOldest' event is dropped
+    dropNewest,             // the new event is dropped
+    conflate                // only the topic's latest unsent event is kept
+};
+
+// for publishStats(), an asynchronous publisher's counters
+//
+struct PublishStats {
+    uint64_t enqueued;
+    uint64_t sent;
+    uint64_t dropped;           // by the overflow policy, or failed to send
+    uint64_t queued;            // events waiting now
+};
+
+// for ChannelQoS, how the channel orders queued events, and which
+// ones it discards first when a queue is full; 'channelDefault'
+// leaves the channel's own policy
+//
+enum class QueuePolicy {
+    channelDefault,
+    anyOrder,
+    fifo,
+    lifo,                   // discard policy only, refused as order policy
+    priority,               // by TopicQoS::priority
+    deadline                // by expiry, the soonest first
+};
+
+// for Options and setChannelQoS(), the event channel's QoS
+// a 0 limit leaves the channel's own default
+//
+struct ChannelQoS {
+    QueuePolicy orderPolicy          = QueuePolicy::channelDefault;
+    QueuePolicy discardPolicy        = QueuePolicy::channelDefault;
+    unsigned    maxEventsPerConsumer = 0;
+    unsigned    maxQueueLength       = 0;   // of the whole channel
+    unsigned    timeoutMs            = 0;   // events expire after it
+};
+
+// for Options and setTopicQoS(), carried by every event of a topic
+//
+struct TopicQoS {
+    short    priority  = 0;     // -32767 (lowest) .. 32767 (highest)
+    unsigned timeoutMs = 0;     // expiry, 0: the channel's
+};
+
+// for pollEvents(), an event pulled from the channel
+//
+struct PolledEvent {
+    std::string topic;
+    std::string data;           // may contain NULs
+};
+typedef std::vector<PolledEvent> PolledEvents;
+
+// for setCallPolicy(), how execCmd() invokes a command
+// 'timeoutMs' bounds every call to a provider (0: the ORB's default);
+// with 'hedge', if a command's provider doesn't answer within the
+// command's 95th percentile latency, the request is sent to another
+// provider of it, too, and the first answer wins; at most
+// 'hedgeBudget' percent of the command's calls are hedged
+//
+struct CallPolicy {
+    unsigned timeoutMs   = 0;
+    bool     hedge       = false;
+    unsigned hedgeBudget = 10;
+};
+
+// for hedgeStats(), hedged requests sent and the ones which answered
+// before the first request
+//
+struct HedgeStats {
+    uint64_t sent;
+    uint64_t won;
+};
+
+// for connect(), optional tuning knobs
+// the defaults are good for most hosts
+//
+struct Options {
+    // execCmdAsync() requests in flight, they hold no thread, one
+    // beyond it is refused (0: unbounded)
+    //
+    unsigned asyncInFlight = 1024;
+
+    // late command routing, how long execCmd() waits for a command
+    // to be routed, and the first retry interval of an unanswered
+    // 'want services' query (at least 1ms, doubled on every retry,
+    // up to 1s)
+    //
+    unsigned routingTimeoutMs = 100;
+    unsigned routingRetryMs   = 25;
+
+    // client's GIOP connections per provider (omniORB's
+    // 'maxGIOPConnectionPerServer'), each call in flight has one of
+    // its own, so a large payload doesn't hold up the other calls;
+    // a call beyond 'connectionsPerProvider' waits for a free one
+    //
+    unsigned connectionsPerProvider = 50;
+
+    // commands offered by more than one provider
+    //
+    BalancePolicy balancePolicy = BalancePolicy::roundRobin;
+
+    // threads which send the first request of a hedged command (the
+    // hedge is sent by the caller), started on the first
+    // setCallPolicy() which asks for hedging; a call which finds
+    // 'hedgeThreads' requests waiting for them isn't hedged
+    //
+    unsigned hedgeThreads = 4;
+
+    // compression, for every command and per-command overrides
+    // (an override with 'enabled = false' turns compression off);
+    // the requester's policy of the command decides
+    //
+    CompressionPolicy                        compression;
+    std::map<std::string, CompressionPolicy> cmdCompression;
+
+    // how many results the client caches, for commands marked
+    // cacheable by cacheCmd(), least recently used ones are evicted
+    //
+    size_t cacheCapacity = 1024;
+
+    // same-host RPC through shared memory (Linux only), both the
+    // provider and the requester must turn it on; a request or a
+    // command name which doesn't fit in a slot goes through CORBA
+    //
+    bool     sharedMemory = false;
+    unsigned shmSlots     = 16;             // requests in flight
+    unsigned shmSlotSize  = 64 * 1024;      // bytes
+    unsigned shmThreads   = 2;              // provider's threads
+
+    // subscriber's event delivery
+    // with 0 'eventThreads', callbacks run on the ORB thread which
+    // delivers the event; otherwise they run on a pool of threads,
+    // a topic's events in order, different topics in parallel
+    //
+    unsigned eventThreads = 0;
+
+    // subscriber's event batching, with 'consumeBatchSize' > 1 the
+    // channel delivers up to 'consumeBatchSize' events per call, 
+    // waiting at most 'consumePacingMs' for a batch to fill
+    //
+    unsigned consumeBatchSize = 1;          // 1: one call per event
+    unsigned consumePacingMs  = 10;
+
+    // subscriber's pull mode, how many events of polled topics the
+    // channel holds for a host which doesn't poll fast enough
+    // (0: the channel's default)
+    //
+    unsigned pollQueueSize = 10000;
+
+    // publisher's event batching, with 'eventBatchSize' > 1 events are
+    // sent to the channel in batches, a batch is sent when it's full
+    // or its oldest event is 'eventBatchDelayMs' old; flushEvents()
+    // sends it at once
+    //
+    unsigned eventBatchSize    = 1;         // 1: one call per event
+    unsigned eventBatchDelayMs = 5;
+
+    // QoS of the event channel, applied when 'CorbaComm' creates it
+    // (please refer to setChannelQoS() for a running channel),
+    // and of the events of topics published by the host
+    //
+    ChannelQoS                      channelQoS;
+    std::map<std::string, TopicQoS> topicQoS;
+
+    // publisher's asynchronous mode, pushEvent()/pushBinEvent() only
+    // queue the event, a thread of 'CorbaComm' sends it, so a slow
+    // channel never stalls the publisher; at most 'publishQueueSize'
+    // events are queued per policy, beyond it the topic's policy applies
+    //
+    bool                                  asyncPublish     = false;
+    unsigned                              publishQueueSize = 1024;
+    OverflowPolicy                        overflowPolicy   = OverflowPolicy::block;
+    std::map<std::string, OverflowPolicy> topicOverflow;     // per-topic
+
+    // command provider's dispatch
+    // with 0 'providerThreads', callbacks run on the ORB thread which
+    // delivers the request; otherwise they run on a pool of threads,
+    // each command has its own bounded queue and commands take turns,
+    // a request beyond a full queue is refused with CORBA::NO_RESOURCES,
+    // the requester's execCmd() returns "" and keeps the provider
+    // the ORB thread of a queued request waits until it's answered
+    // a command of this host's own is called directly on the caller's
+    // thread, neither queued nor limited
+    //
+    unsigned                         providerThreads = 0;
+    CmdLimits                        providerLimits;  // for every command
+    std::map<std::string, CmdLimits> cmdLimits;       // per-command
+};
+
 class CorbaCommImpl;
 
 class CorbaComm {
@@ -45,29 +346,137 @@ public:
                                    // can't be nullptr or empty string
            Commands offerCommands, // commands the host offers, can be empty
            Commands wantCommands,  // commands the host wants, can be empty
-           int argc, char* argv[]);// additional argc/argv
+           int argc, char* argv[], // additional argc/argv
                                    // to init exchange server
+           const Options& options = Options());
 
     // for subscriber, subscriber's 'onEvent()' will be invoked 
     // when an event arrives
     //
     virtual SID onEvent(const char* topic, EventCallback_t callback);
+    virtual SID onBinEvent(const char* topic, BinaryEventCallback_t callback);
+
+    // the same as 'onEvent()', but the callback gets the events of 'topic'
+    // a batch from the channel holds (please refer to 'consumeBatchSize'),
+    // after they're dispatched to per-event callbacks
+    //
+    virtual SID onEventBatch(const char* topic, EventBatchCallback_t callback);
+    virtual DispatchStats dispatchStats() const;
     virtual void detachEvent(const SID&);
 
+    // pull mode, for subscribers which consume at their own pace
+    // events of polled topics are held by the channel until
+    // 'pollEvents()' drains them, up to 'maxBatch' per call; it waits
+    // at most 'timeoutMs' for the first event
+    // polling is independent of 'onEvent()', a topic both polled and
+    // subscribed has its events delivered to the callbacks, too
+    //
+    virtual bool pollTopic(const char* topic);
+    virtual void unpollTopic(const char* topic);
+    virtual PolledEvents pollEvents(size_t maxBatch, unsigned timeoutMs = 0);
+
     // for publisher to push an event 'topic'
+    // 'pushBinEvent()' carries a binary 'data', which may contain NULs
     //
     virtual bool pushEvent(const char* topic, const char* param);
+    virtual bool pushBinEvent(const char* topic, 
+                              const void* data, size_t length);
+
+    // sends the batched events now, please refer to 'eventBatchSize'
+    // false if they can't be sent to the channel; with 'asyncPublish',
+    // it waits for the queued events to be sent first
+    //
+    virtual bool flushEvents();
+    virtual PublishStats publishStats() const;
+
+    // QoS, please refer to 'ChannelQoS' and 'TopicQoS'
+    // 'setChannelQoS()' changes the event channel every host shares,
+    // false if the channel doesn't support it, or the order policy is
+    // 'lifo' (nothing is changed then); 'setTopicQoS()' applies
+    // to the topic's events published after it
+    //
+    virtual bool setChannelQoS(const ChannelQoS& qos);
+    virtual void setTopicQoS(const char* topic, const TopicQoS& qos);
 
     // for hosts which request data from the other host, or
     // for hosts which ask the host do do some action
     //
     virtual std::string execCmd(const char* cmd, const char* param);
 
+    // the same as 'execCmd()', but by an id got from 'internCmd()'
+    // the requester indexes its routing table by the id instead of
+    // looking the name up; the name is still sent, the provider checks
+    // its own id of the command against it, and with 'providerThreads'
+    // its scheduler queues the request by name
+    //
+    virtual CmdId internCmd(const char* cmd);
+    virtual std::string execCmdById(CmdId id, const char* param);
+
+    // fire-and-forget 'execCmd()' for commands whose result is of no
+    // use (writes); it doesn't wait for the provider, so posted commands
+    // are pipelined; returns false if the command can't be routed
+    // 'flushCmds()' waits until every command posted before is processed
+    // by its provider, even one dropped since; false if it's not
+    // confirmed within 'timeoutMs', or a provider restarted since the
+    // flush before or can't be reached (its commands may be lost, they
+    // are written off, the next flush waits only for commands posted
+    // since)
+    //
+    virtual bool postCmd(const char* cmd, const char* param);
+    virtual bool flushCmds(unsigned timeoutMs = 1000);
+
+    // for idempotent commands (pure reads) only
+    // results of 'cmd' are cached by (cmd, param) for 'ttlMs', and
+    // 'execCmd()' serves them without a round trip; 0 'ttlMs' stops it
+    // empty results are never cached
+    //
+    virtual void cacheCmd(const char* cmd, unsigned ttlMs);
+    virtual CacheStats cacheStats() const;
+
+    // a command's timeout and hedging, please refer to 'CallPolicy'
+    // a command which times out returns an empty string ""
+    //
+    virtual void setCallPolicy(const char* cmd, const CallPolicy& policy);
+    virtual HedgeStats hedgeStats() const;
+
+    // the same as 'execCmd()', but both the request and the response
+    // are binary-safe; the returned string may contain NULs
+    //
+    virtual std::string execBinCmd(const char* cmd, 
+                                   const void* data, size_t length);
+
+    // the same as the above, but the status tells a failed command from
+    // an empty result; 'result' is empty unless it's 'CmdStatus::done'
+    //
+    virtual CmdStatus execBinCmd(const char* cmd, 
+                                 const void* data, size_t length,
+                                 std::string& result);
+
+    // the same as 'execCmd()', but it doesn't wait for the provider:
+    // the request is sent by CORBA AMI, no thread waits for its reply,
+    // and the result is delivered either via the future or the callback
+    // with the command's status, so a failure isn't an empty result;
+    // if 'asyncInFlight' requests are in flight already, it's refused
+    // with 'CmdStatus::overloaded' at once
+    // it's never hedged, nor sent through shared memory
+    //
+    virtual std::future<CmdResult> execCmdAsync(const char* cmd, 
+                                                const char* param);
+    virtual void execCmdAsync(const char* cmd, const char* param,
+                              CompletionCallback_t callback);
+
+    // execute many commands at once, commands offered by the same
+    // provider cost only one round trip
+    // a command which can't be routed has an empty result ""
+    //
+    virtual Results execBatch(const CmdRequests& requests);
+
     // for hosts which offer the command 'cmd'
     // when a client request a command by 'execCmd()'
     // command provider's 'onCmd()' will be called
     //
     virtual void onCmd(const char* cmd, CommandCallback_t cmdCallback); 
+    virtual void onBinCmd(const char* cmd, BinaryCommandCallback_t cmdCallback);
 
     // Big-5 rule
     //
@@ -84,7 +493,8 @@ private:
               Commands offerCommands, 
               Commands wantCommands,
               int argc, 
-              char* argv[]);
+              char* argv[],
+              const Options& options);
     static CorbaComm*     _ccserver;
     static CorbaCommImpl* _impl;
 };
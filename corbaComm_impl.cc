@@ -8,16 +8,37 @@
 #include <chrono>
 #include <sstream>
 #include <cstring>
+#include <cstdlib>
+#include <random>
+#include <limits>
+#include <functional>
 #include "corbaComm_impl.h"
 #include "corbaComm.hh"
 #include "cos.h"
 #include "notify_impl.h"
 #include "provider.h"
+#include "dispatcher.h"
+#include "resultcache.h"
+#include "batcher.h"
+#include "executor.h"
+#include "publishq.h"
 #include <omniORB4/omniZIOP.h>
 
 static cc::CorbaCommImpl*  _impl;
 
+// the longest interval between two 'want services' queries of a command
+//
+static const unsigned maxRoutingBackoffMs = 1000;
+
+// routing announcements have a channel of their own,
+// everything on the event channel is an application event
+//
 static void consumeCallback(const CosN::StructuredEvent& event)
+{
+    ::_impl->tryDispatchEvent(event);
+}
+
+static void consumeControlCallback(const CosN::StructuredEvent& event)
 {
     const char*  check = (const char*)event.filterable_data[1].name;
     
@@ -27,9 +48,11 @@ static void consumeCallback(const CosN::StructuredEvent& event)
     else if (0 == std::strcmp(check, "want services")) {
         ::_impl->tryPublishOfferService(event);
     }
-    else {
-        ::_impl->tryDispatchEvent(event);
-    }
+}
+
+static void consumeBatchCallback(const CosN::EventBatch& batch)
+{
+    ::_impl->tryDispatchEvents(batch);
 }
 
 // command provider will call this special command, cmd == _hostId
@@ -43,7 +66,14 @@ static std::string cmdProviderResponse(const std::string& cmd,
     getline(strm, command, ';');
     std::string provider;
     getline(strm, provider, ':');
-    cc::CorbaCommImpl::Cmd2ProviderInfo info = {command, provider};
+    std::string cmdId;
+    getline(strm, cmdId, ':');
+    std::string epoch;
+    getline(strm, epoch);
+    cc::CorbaCommImpl::Cmd2ProviderInfo info = {
+        command, provider, cmdId.empty() ? -1 : std::atoi(cmdId.c_str()),
+        std::strtoull(epoch.c_str(), nullptr, 10)
+    };
     ::_impl->trySetProviderInfo(info);
     return "";
 }
@@ -51,17 +81,40 @@ static std::string cmdProviderResponse(const std::string& cmd,
 cc::CorbaCommImpl::CorbaCommImpl(const char*  hostId,
                                  cc::Commands offerCommands,
                                  cc::Commands wantCommands,
-                                 int argc, char* argv[]) 
+                                 int argc, char* argv[],
+                                 const cc::Options& options) 
                   : _pushSupplier{nullptr}
+                  , _seqPushSupplier{nullptr}
                   , _pushConsumer{nullptr}
+                  , _seqPushConsumer{nullptr}
+                  , _controlSupplier{nullptr}
+                  , _controlConsumer{nullptr}
+                  , _topicFilter{CosNF::Filter::_nil()}
+                  , _pullConsumer{nullptr}
+                  , _pollFilter{CosNF::Filter::_nil()}
                   , _orb{CORBA::ORB::_nil()}
                   , _poa{PortableServer::POA::_nil()}
                   , _nameCtx{CosNaming::NamingContext::_nil()} 
                   , _orbRunning{false}
 {
     _hostId        = hostId;
-    _offerCommands = offerCommands;
-    _wantCommands  = wantCommands;
+    _options       = options;
+    _cache         = std::make_unique<cc::ResultCache>(_options.cacheCapacity);
+    _topicQoS      = 
+    std::make_shared<const std::map<std::string, cc::TopicQoS>>(
+                                                    _options.topicQoS);
+    if (_options.eventThreads > 0)
+        _executor  = std::make_unique<cc::Executor>(_options.eventThreads);
+    _compression.push_back(_options.compression);
+    for (const auto& cmdCompression : _options.cmdCompression)
+        _compression.push_back(cmdCompression.second);
+
+    auto table = std::make_shared<RoutingTable>();
+    table->offerCommands.insert(offerCommands.begin(), offerCommands.end());
+    for (const auto& cmd : wantCommands)
+        internCmd(*table, cmd.c_str());
+    _routing = table;
+    _subscriptions = std::make_shared<Subscriptions>();
 
     // * * * * * * * * N O T E * * * * * * * *
     //
@@ -75,12 +128,17 @@ cc::CorbaCommImpl::CorbaCommImpl(const char*  hostId,
     // * * * * * * * * N O T E * * * * * * * *
     
     try {
+        // a call in flight has a GIOP connection of its own, omniORB
+        // opens up to 'connectionsPerProvider' per provider, a call
+        // beyond it waits for a free one
+        //
+        const std::string maxConnections = 
+        std::to_string(std::max(1u, _options.connectionsPerProvider));
         const char* options[][2] = {
-            { "maxGIOPConnectionPerServer", "50" },
+            { "maxGIOPConnectionPerServer", maxConnections.c_str() },
             { (const char*)0, (const char*)0 },
         };
-        CORBA::PolicyList pl;
-        omniZIOP::setGlobalPolicies(pl);
+        omniZIOP::setGlobalPolicies(compressionPolicies(_options.compression));
         _orb = CORBA::ORB_init(argc, argv, "omniORB4", options);
         CORBA::Object_var obj; 
         obj = _orb->resolve_initial_references("RootPOA");
@@ -92,15 +150,28 @@ cc::CorbaCommImpl::CorbaCommImpl(const char*  hostId,
         if (!initPushSupplier()) 
             throw cc::CorbaCommImpl::SupplierFailureException();
 
+        if (_options.asyncPublish)
+            _publishQueue = std::make_unique<cc::PublishQueue>(
+                _options.publishQueueSize, _options.overflowPolicy,
+                _options.topicOverflow,
+                [this](const CosN::StructuredEvent& ev) {
+                    return sendEvent(ev);
+                });
+
         if (!initPushConsumer())
             throw cc::CorbaCommImpl::ConsumerFailureException();
 
+        if (!initControlChannel())
+            throw cc::CorbaCommImpl::ConsumerFailureException();
+
         // every app is a 'command provider', and offer a special command
         // which command name is identical to _hostId.
-        // this command is to receive provider's response
+        // this command is to receive provider's response,
+        // it's answered at once, even if the provider's threads are busy
         newProviderCorbaObject();
         onCmd(_hostId.c_str(), cmdProviderResponse); 
-        if (_offerCommands.size() > 0 ) 
+        _providerImpl->exempt(_hostId.c_str());
+        if (offerCommands.size() > 0 ) 
             publishOfferCommands(offerCommands);
 
         if (wantCommands.size() > 0)
@@ -139,38 +210,222 @@ cc::CorbaCommImpl::CorbaCommImpl(const char*  hostId,
 
 cc::CorbaCommImpl::~CorbaCommImpl() 
 {
+    // finish in-flight 'execCmdAsync()' and hedged requests
+    // while everything is still alive
+    //
+    {
+        std::unique_lock<std::mutex> lock(_asyncMutex);
+        _asyncCv.wait(lock, [this]() { return 0 == _asyncInFlight.load(); });
+    }
+    _hedger.reset();
+    _executor.reset();
+
+    // send the events still queued, then the ones still batched
+    //
+    _publishQueue.reset();
+    _batcher.reset();
+}
+
+// the body is either a string ('pushEvent()') or
+// an octet sequence ('pushBinEvent()'), both are borrowed, not copied
+//
+// static
+bool cc::CorbaCommImpl::eventBody(const CosN::StructuredEvent& event,
+                                  const char*& topic,
+                                  const char*& data, size_t& length)
+{
+    const char*                     param;
+    const CorbaCommModule::Octets*  binParam;
+
+    event.filterable_data[1].value >>= topic;
+    if (event.remainder_of_body >>= param) {
+        data   = param;
+        length = std::strlen(param);
+    }
+    else if (event.remainder_of_body >>= binParam) {
+        data   = (const char*)binParam->get_buffer();
+        length = binParam->length();
+    }
+    else
+        return false;
+    return true;
 }
 
 void cc::CorbaCommImpl::tryDispatchEvent(
                              const CosN::StructuredEvent& event) const
 {
-    const char*             param;
-    const char*             ev;
+    const char*  ev;
+    const char*  data;
+    size_t       length;
+
+    if (!eventBody(event, ev, data, length))
+        return;
+
+    // an event not delivered in a batch is a batch of one
+    //
+    if (_executor) {
+        deliverEvents(ev, cc::EventViews{{data, length}});
+        return;
+    }
+
+    // without allocating, unless there are batch callbacks
+    //
+    SubscriptionSnapshot table = subscriptions();
+    dispatchEvent(*table, ev, data, length);
+    if (table->batchSubscribeMap.count(ev) > 0)
+        dispatchBatch(*table, ev, cc::EventViews{{data, length}});
+}
+
+// a batch from the channel may mix topics
+// on the ORB thread, events are delivered as they arrived, a batch
+// callback gets each run of consecutive events of its topic; with
+// the executor, they're grouped by topic, each topic's events in order
+//
+void cc::CorbaCommImpl::tryDispatchEvents(const CosN::EventBatch& batch)
+{
+    const char*  ev;
+    const char*  data;
+    size_t       length;
+
+    if (_executor) {
+        std::map<std::string, cc::EventViews> topics;
+        for (CORBA::ULong i = 0; i < batch.length(); ++i) {
+            if (eventBody(batch[i], ev, data, length))
+                topics[ev].emplace_back(data, length);
+        }
+        for (const auto& topic : topics)
+            deliverEvents(topic.first.c_str(), topic.second);
+        return;
+    }
+
+    SubscriptionSnapshot table = subscriptions();
+    std::string          runTopic;
+    cc::EventViews       run;
+    for (CORBA::ULong i = 0; i < batch.length(); ++i) {
+        if (!eventBody(batch[i], ev, data, length))
+            continue;
+        if (!run.empty() && runTopic != ev) {
+            dispatchBatch(*table, runTopic.c_str(), run);
+            run.clear();
+        }
+        dispatchEvent(*table, ev, data, length);
+        if (table->batchSubscribeMap.count(ev) > 0) {
+            if (run.empty())
+                runTopic = ev;
+            run.emplace_back(data, length);
+        }
+    }
+    if (!run.empty())
+        dispatchBatch(*table, runTopic.c_str(), run);
+}
+
+// for 'eventThreads', the events are copied and delivered by the
+// executor, a topic's events in order
+//
+void cc::CorbaCommImpl::deliverEvents(const char* ev, 
+                                      const cc::EventViews& events) const
+{
+    std::vector<std::string> bodies;
+    bodies.reserve(events.size());
+    for (const auto& event : events)
+        bodies.emplace_back(event.first, event.second);
+
+    std::string topic(ev);
+    _executor->post(topic, [this, topic, bodies]() {
+        cc::EventViews views;
+        views.reserve(bodies.size());
+        for (const auto& body : bodies)
+            views.emplace_back(body.data(), body.size());
+        dispatchEvents(topic.c_str(), views);
+    });
+}
+
+// per-event callbacks, then the topic's batch callbacks
+//
+void cc::CorbaCommImpl::dispatchEvents(const char* ev, 
+                                       const cc::EventViews& events) const
+{
+    SubscriptionSnapshot table = subscriptions();
+    for (const auto& event : events)
+        dispatchEvent(*table, ev, event.first, event.second);
+    dispatchBatch(*table, ev, events);
+}
+
+// callbacks are called straight from the snapshot, which is held
+// while they run, so a callback may subscribe or detach
+//
+// a text callback takes a 'std::string', the body is assigned to a
+// buffer of the thread, which keeps its capacity: no allocation once
+// it's grown to the largest body; a callback whose event is dispatched
+// on the same thread (it publishes, say) gets a string of its own
+//
+void cc::CorbaCommImpl::dispatchEvent(const Subscriptions& table,
+                                      const char* ev, 
+                                      const char* data, size_t length) const
+{
+    auto itr = table.subscribeMap.find(ev);
+    if (itr != table.subscribeMap.end()) {
+        static thread_local std::string buffer;
+        static thread_local bool        inUse = false;
+
+        std::string  nested;
+        std::string& text  = inUse ? nested : buffer;
+        bool         owner = !inUse;
+        text.assign(data, length);
+        inUse = true;
+        try {
+            for (auto callback: itr->second) 
+                (*callback)(itr->first, text); 
+        }
+        catch (...) {
+            inUse = !owner;
+            throw;
+        }
+        inUse = !owner;
+    }
 
-    event.filterable_data[1].value >>= ev;
-    event.remainder_of_body >>= param;
+    auto binItr = table.binSubscribeMap.find(ev);
+    if (binItr != table.binSubscribeMap.end()) {
+        for (auto callback: binItr->second) 
+            (*callback)(binItr->first, data, length); 
+    }
+}
 
-    auto itr = _subscribeMap.find(ev);
-    if (itr != _subscribeMap.end()) {
-        auto allCallbacks = itr->second;
-        for (auto callback: allCallbacks) 
-            (*callback)(ev, param); 
+void cc::CorbaCommImpl::dispatchBatch(const Subscriptions& table,
+                                      const char* ev,
+                                      const cc::EventViews& events) const
+{
+    auto batchItr = table.batchSubscribeMap.find(ev);
+    if (batchItr != table.batchSubscribeMap.end()) {
+        for (auto callback: batchItr->second) 
+            (*callback)(batchItr->first, events); 
     }
 }
 
 void cc::CorbaCommImpl::trySetProviderInfo(const CosN::StructuredEvent& event)
 {
-    if (_wantCommands.size() > 0 ) {
-        const char* cmd;
-        event.filterable_data[1].value >>= cmd;
-        if (std::find(_wantCommands.begin(), _wantCommands.end(), cmd)
-            != _wantCommands.end())
-        {
-            const char* provider;
-            event.filterable_data[0].value >>= provider;
-            _providerInfoMap[cmd] = std::string(provider);
-            clearObjReference(provider);
+    const char* cmd;
+    event.filterable_data[1].value >>= cmd;
+    if (routing()->wantCommands.count(cmd) > 0) {
+        const char* provider;
+        event.filterable_data[0].value >>= provider;
+
+        // the provider announces its id of the command and its epoch
+        // in the body, "id:epoch"
+        //
+        const char* body;
+        CORBA::Long cmdId = -1;
+        uint64_t    epoch = 0;
+        if ((event.remainder_of_body >>= body) && body[0] != '\0') {
+            cmdId = std::atoi(body);
+            if (const char* colon = std::strchr(body, ':'))
+                epoch = std::strtoull(colon + 1, nullptr, 10);
         }
+
+        updateRouting([&](RoutingTable& table) {
+            addReplica(table, cmd, provider, cmdId, epoch);
+            table.objRefMap.erase(provider);
+        });
         unblockedCmd(cmd);
     }
 }
@@ -178,237 +433,1604 @@ void cc::CorbaCommImpl::trySetProviderInfo(const CosN::StructuredEvent& event)
 void cc::CorbaCommImpl::trySetProviderInfo(
                             const cc::CorbaCommImpl::Cmd2ProviderInfo& info)
 {
-    if (_wantCommands.size() > 0) {
-        if (std::find(_wantCommands.begin(), _wantCommands.end(), info.first) 
-            != _wantCommands.end()) 
-        {
-            _providerInfoMap[info.first] = info.second;
+    if (routing()->wantCommands.count(info.cmd) > 0) {
+        updateRouting([&](RoutingTable& table) {
+            addReplica(table, info.cmd.c_str(), 
+                       info.provider.c_str(), info.cmdId, info.epoch);
+        });
+        unblockedCmd(info.cmd);
+    }
+}
+
+// a command may be offered by many providers, 
+// a provider which offers it again only updates its id
+//
+// commands are posted to the provider's epoch; a restarted provider
+// (another epoch) is posted to at once if every command posted before
+// is settled, otherwise the next flush finds the restart
+//
+// static
+void cc::CorbaCommImpl::addReplica(RoutingTable& table, const char* cmd,
+                                   const char* provider, CORBA::Long cmdId,
+                                   uint64_t epoch)
+{
+    auto& load = table.loads[provider];
+    if (!load)
+        load = std::make_shared<Load>();
+    {
+        std::lock_guard<std::mutex> lock(load->postMutex);
+        if (0 == load->epoch || load->posted == load->settled) {
+            if (load->epoch != epoch)
+                load->posted = load->settled = 0;
+            load->epoch = epoch;
+        }
+    }
+
+    auto& route = table.routes[table.wantCommands.find(cmd)->second];
+    for (auto& replica : route.replicas) {
+        if (replica.provider == provider) {
+            replica.cmdId = cmdId;
+            return;
         }
-        unblockedCmd(info.first);
     }
+    route.replicas.push_back({provider, cmdId, load});
+}
+
+// static
+bool cc::CorbaCommImpl::settledLoad(Load& load)
+{
+    std::lock_guard<std::mutex> lock(load.postMutex);
+    return load.posted == load.settled;
+}
+
+// static
+bool cc::CorbaCommImpl::routed(const RoutingTable& table, 
+                               const std::string& provider)
+{
+    for (const auto& route : table.routes)
+        for (const auto& replica : route.replicas)
+            if (replica.provider == provider)
+                return true;
+    return false;
 }
 
 void cc::CorbaCommImpl::tryPublishOfferService(
-                            const CosN::StructuredEvent& event) const
-{
-    if (_offerCommands.size() > 0) {
-        const char* querier;
-        event.filterable_data[0].value >>= querier;
-        const char* cmd;
-        event.filterable_data[1].value >>= cmd;
-        auto itr = std::find(std::begin(_offerCommands), 
-                             std::end(_offerCommands), cmd);
-
-        // the provider will 'execCmd' to notify command requester
-        //
-        if (itr != std::end(_offerCommands)) {
-            CosNaming::Name name;
-            name.length(2);
-            name[0].id   = "edwardlintw";
-            name[0].kind = "com";
-            name[1].id   = querier;
-            name[1].kind = "provider";
+                            const CosN::StructuredEvent& event)
+{
+    const char* querier;
+    event.filterable_data[0].value >>= querier;
+    const char* cmd;
+    event.filterable_data[1].value >>= cmd;
 
-            try {
-                CORBA::Object_var obj          = resolveObjectReference(name);
-                CorbaCommModule::Provider_ptr  providerRef  = 
-                CorbaCommModule::Provider::_narrow(obj);
-                std::string param;
-                param.append(cmd).append(";").append(_hostId);
-                providerRef->execCmd(querier, param.c_str());
-            }
-            catch (...) {
-                ;
+    // the provider will 'execCmd' to notify command requester
+    //
+    // the answer is the command 'querier', under its compression policy
+    //
+    if (routing()->offerCommands.count(cmd) > 0) {
+        try {
+            ProviderRef::Handle providerRef = 
+            getObjReference(querier, compressionOf(querier));
+            if (!providerRef)
+                return;
+            std::string param;
+            param.append(cmd).append(";").append(_hostId).append(":")
+                 .append(std::to_string(_providerImpl->intern(cmd)))
+                 .append(":")
+                 .append(std::to_string(_providerImpl->epoch()));
+            providerRef->execCmd(querier, param.c_str());
+        }
+        catch (CORBA::NO_RESOURCES&) {
+            // the querier is busy, not gone, it'll query again
+            //
+        }
+        catch (...) {
+            dropProvider(querier);
+        }
+    }
+}
+
+cc::SID cc::CorbaCommImpl::onEvent(const char* topic,
+                                   cc::EventCallback_t callback) 
+{
+    return subscribe(&Subscriptions::subscribeMap, 
+                     &Subscriptions::evtInfoMap, topic, callback);
+}
+
+cc::SID cc::CorbaCommImpl::onBinEvent(const char* topic,
+                                      cc::BinaryEventCallback_t callback) 
+{
+    return subscribe(&Subscriptions::binSubscribeMap, 
+                     &Subscriptions::binEvtInfoMap, topic, callback);
+}
+
+cc::SID cc::CorbaCommImpl::onEventBatch(const char* topic,
+                                        cc::EventBatchCallback_t callback) 
+{
+    return subscribe(&Subscriptions::batchSubscribeMap, 
+                     &Subscriptions::batchEvtInfoMap, topic, callback);
+}
+
+cc::CorbaCommImpl::SubscriptionSnapshot 
+cc::CorbaCommImpl::subscriptions() const
+{
+    return std::atomic_load(&_subscriptions);
+}
+
+// must be called with '_subscriptionMutex' locked
+// the filter is changed by the same writer, so it follows the table;
+// it's changed first, a table whose topic the channel won't deliver
+// is never published; false if so
+//
+// the filter is remote, a slow channel holds the mutex, but only
+// (un)subscribing waits for it, the delivering threads never lock it
+//
+bool cc::CorbaCommImpl::publishSubscriptions(
+                           std::shared_ptr<Subscriptions> table,
+                           const std::string& topic)
+{
+    if (!syncTopicFilter(*table, topic))
+        return false;
+    std::atomic_store(&_subscriptions, SubscriptionSnapshot(table));
+    return true;
+}
+
+// a subscription is added to a copy of the table, and
+// the copy is published
+//
+template <typename Callback>
+cc::SID cc::CorbaCommImpl::subscribe(
+    std::map<std::string, std::vector<Callback>, std::less<>> 
+                                             Subscriptions::*subscribeMap,
+    std::map<SID, std::pair<std::string, Callback>> Subscriptions::*infoMap,
+    const char* topic,
+    Callback    callback)
+{
+    if (nullptr == topic|| 0 == std::strcmp(topic,""))
+        return "";
+
+    std::lock_guard<std::mutex> lock(_subscriptionMutex);
+    const auto& current = (*subscriptions()).*subscribeMap;
+    auto which = current.find(topic);
+    if (which != current.end()) {
+        const auto& all = which->second;
+        if (std::find(std::begin(all), std::end(all), callback) != 
+            std::end(all))
+            return "";
+    }
+
+    auto table = std::make_shared<Subscriptions>(*subscriptions());
+    ((*table).*subscribeMap)[topic].push_back(callback);
+    auto sid = genSID();
+    ((*table).*infoMap)[sid] = {topic, callback};
+    if (!publishSubscriptions(table, topic))
+        return "";
+    return sid;
+}
+
+void cc::CorbaCommImpl::detachEvent(const SID& sid)
+{
+    std::lock_guard<std::mutex> lock(_subscriptionMutex);
+    auto table = std::make_shared<Subscriptions>(*subscriptions());
+    std::string topic;
+    if (unsubscribe(table->subscribeMap, table->evtInfoMap, sid, topic) ||
+        unsubscribe(table->binSubscribeMap, table->binEvtInfoMap, sid, topic) ||
+        unsubscribe(table->batchSubscribeMap, table->batchEvtInfoMap, 
+                    sid, topic))
+        publishSubscriptions(table, topic);
+}
+
+// 'topic' is the one of the subscription, if it's found
+//
+template <typename Callback>
+bool cc::CorbaCommImpl::unsubscribe(
+         std::map<std::string, std::vector<Callback>, std::less<>>& 
+                                                          subscribeMap,
+         std::map<SID, std::pair<std::string, Callback>>& infoMap,
+         const SID&   sid,
+         std::string& topic)
+{
+    auto evtInfoItr = infoMap.find(sid);
+    if (evtInfoItr != infoMap.end()) {
+        topic = evtInfoItr->second.first;
+        auto callback = evtInfoItr->second.second;
+        auto which = subscribeMap.find(topic);
+        if (which != subscribeMap.end()) {
+            auto& callbacks = which->second;
+            callbacks.erase(
+            std::remove(std::begin(callbacks), std::end(callbacks), callback),
+            std::end(callbacks));
+            if (callbacks.empty())
+                subscribeMap.erase(which);
+        } 
+        infoMap.erase(evtInfoItr);
+        return true;
+    }
+    return false;
+}
+
+// a string literal of the filter constraint grammar
+//
+// static
+std::string cc::CorbaCommImpl::tclString(const std::string& text)
+{
+    std::string literal("'");
+    for (char c : text) {
+        if ('\'' == c || '\\' == c)
+            literal += '\\';
+        literal += c;
+    }
+    return literal += '\'';
+}
+
+// keeps a constraint per subscribed topic in the consumer's filter,
+// so the channel delivers only what this host subscribes to
+// constraints of a filter are OR'ed, each one repeats the sender check
+//
+// must be called with '_subscriptionMutex' locked
+// false if the topic's constraint can't be added; a constraint which
+// can't be removed only lets unwanted events through, they're dropped
+//
+bool cc::CorbaCommImpl::syncTopicFilter(const Subscriptions& table,
+                                        const std::string& topic)
+{
+    const bool wanted = table.subscribeMap.count(topic)    > 0 ||
+                        table.binSubscribeMap.count(topic) > 0 ||
+                        table.batchSubscribeMap.count(topic) > 0;
+
+    auto which = _topicConstraints.find(topic);
+    if (CORBA::is_nil(_topicFilter) || 
+        wanted == (which != _topicConstraints.end()))
+        return true;
+
+    if (wanted) {
+        CosNF::ConstraintID id;
+        if (!addTopicConstraint(_topicFilter, topic, id))
+            return false;
+        _topicConstraints[topic] = id;
+    }
+    else {
+        removeConstraint(_topicFilter, which->second, topic);
+        _topicConstraints.erase(which);
+    }
+    return true;
+}
+
+// a filter constraint which passes others' events of 'topic'
+//
+bool cc::CorbaCommImpl::addTopicConstraint(CosNF::Filter_ptr    filter,
+                                           const std::string&   topic,
+                                           CosNF::ConstraintID& id) const
+{
+    try {
+        std::string expr = "$sender != " + tclString(_hostId) + 
+                           " and $command == " + tclString(topic);
+        CosNF::ConstraintExpSeq exp;
+        exp.length(1);
+        exp[0].event_types.length(0);
+        exp[0].constraint_expr = CORBA::string_dup(expr.c_str());
+        CosNF::ConstraintInfoSeq_var info = filter->add_constraints(exp);
+        id = info[0].constraint_id;
+        return true;
+    }
+    catch (...) {
+        std::cerr << "Can't change the filter of topic " << topic << "\n";
+        return false;
+    }
+}
+
+// static
+void cc::CorbaCommImpl::removeConstraint(CosNF::Filter_ptr   filter,
+                                         CosNF::ConstraintID id,
+                                         const std::string&  topic)
+{
+    try {
+        CosNF::ConstraintIDSeq   ids;
+        CosNF::ConstraintInfoSeq none;
+        ids.length(1);
+        ids[0] = id;
+        none.length(0);
+        filter->modify_constraints(ids, none);
+    }
+    catch (...) {
+        std::cerr << "Can't change the filter of topic " << topic << "\n";
+    }
+}
+
+// pull mode, the host drains the events of its polled topics by
+// 'pollEvents()'; the pull consumer is connected by the first topic
+//
+bool cc::CorbaCommImpl::pollTopic(const char* topic)
+{
+    if (nullptr == topic || '\0' == *topic)
+        return false;
+
+    std::lock_guard<std::mutex> lock(_pollMutex);
+    if (!_pullConsumer && !initPullConsumer())
+        return false;
+    if (_pollConstraints.count(topic) > 0)
+        return true;
+
+    CosNF::ConstraintID id;
+    if (!addTopicConstraint(_pollFilter, topic, id))
+        return false;
+    _pollConstraints[topic] = id;
+    return true;
+}
+
+void cc::CorbaCommImpl::unpollTopic(const char* topic)
+{
+    if (nullptr == topic)
+        return;
+
+    std::lock_guard<std::mutex> lock(_pollMutex);
+    auto which = _pollConstraints.find(topic);
+    if (which == _pollConstraints.end())
+        return;
+    removeConstraint(_pollFilter, which->second, topic);
+    _pollConstraints.erase(which);
+}
+
+// returns what the channel holds, up to 'maxBatch' events, at once;
+// if it holds none, polls it with backoff until 'timeoutMs' is up
+//
+cc::PolledEvents cc::CorbaCommImpl::pollEvents(size_t   maxBatch, 
+                                               unsigned timeoutMs)
+{
+    cc::PolledEvents    events;
+    SequencePullConsumer_i* consumer;
+    {
+        std::lock_guard<std::mutex> lock(_pollMutex);
+        consumer = _pullConsumer;
+    }
+    if (!consumer || 0 == maxBatch)
+        return events;
+
+    using namespace std::chrono;
+    const auto deadline = steady_clock::now() + milliseconds(timeoutMs);
+    auto       backoff  = milliseconds(1);
+    const auto maxWait  = milliseconds(50);
+    const CORBA::Long max = (CORBA::Long)
+    std::min<size_t>(maxBatch, std::numeric_limits<CORBA::Long>::max());
+
+    while (true) {
+        CORBA::Boolean        hasEvent = false;
+        CosN::EventBatch_var  batch;
+        try {
+            batch = consumer->pull(max, hasEvent);
+        }
+        catch (...) {
+            std::cerr << "Can't pull events from the channel\n";
+            return events;
+        }
+
+        if (hasEvent) {
+            events.reserve(batch->length());
+            for (CORBA::ULong i = 0; i < batch->length(); ++i) {
+                const char*  ev;
+                const char*  data;
+                size_t       length;
+                if (eventBody(batch[i], ev, data, length))
+                    events.push_back({ev, std::string(data, length)});
             }
+            return events;
+        }
+
+        auto now = steady_clock::now();
+        if (now >= deadline)
+            return events;
+        std::this_thread::sleep_for(std::min(backoff, 
+                                    duration_cast<milliseconds>(deadline - now)));
+        backoff = std::min(backoff * 2, maxWait);
+    }
+}
+
+cc::CorbaCommImpl::Filters 
+cc::CorbaCommImpl::eventFilters(const char* topic) const
+{
+    cc::CorbaCommImpl::Filters filters = {{
+        std::make_pair(std::string("sender"),  _hostId),
+        std::make_pair(std::string("command"), std::string(topic))
+    }};
+    return filters;
+}
+
+bool cc::CorbaCommImpl::pushEvent(const char* topic, 
+                                  const char* param) const
+{
+    // bridge to the other overloading 'pushEvent'
+    //
+    return pushEvent(topic, param, eventFilters(topic));
+}
+
+bool cc::CorbaCommImpl::pushBinEvent(const char* topic, 
+                                     const void* data, 
+                                     size_t      length) const
+{
+    CosN::StructuredEvent ev;
+
+    // the Any owns the sequence, but the sequence only borrows
+    // caller's buffer, which outlives this synchronous push
+    // (a batched event is copied into its batch before returning)
+    //
+    ev.remainder_of_body <<= 
+    new CorbaCommModule::Octets(length, length, (CORBA::Octet*)data, false);
+    return pushStructuredEvent(ev, eventFilters(topic));
+}
+
+bool cc::CorbaCommImpl::pushEvent(
+                           const char* topic, 
+                           const char* param,
+                           const cc::CorbaCommImpl::Filters& filters) const
+{
+    CosN::StructuredEvent ev;
+
+    ev.remainder_of_body <<= param;
+    return pushStructuredEvent(ev, filters);
+}
+
+// 'control' events (routing announcements) go to the control channel,
+// at once, never batched
+//
+bool cc::CorbaCommImpl::pushStructuredEvent(
+                           CosN::StructuredEvent& ev,
+                           const cc::CorbaCommImpl::Filters& filters,
+                           bool control) const
+{
+    try {
+
+        // setup event header (for filtering)
+        //
+        ev.header.fixed_header.event_type.domain_name = "";
+        ev.header.fixed_header.event_type.type_name   = "";
+        ev.header.variable_header.length(0);
+        if (!control)
+            topicHeader(ev, filters[1].second);
+        ev.filterable_data.length(filters.size());
+        size_t  i = 0;
+        for (const auto& filter : filters) {
+            ev.filterable_data[i].name    = filter.first.c_str();
+            ev.filterable_data[i].value <<= filter.second.c_str();
+            ++i;
+        }
+
+        if (control) {
+            _controlSupplier->push(ev);
+            return true;
         }
+        if (_publishQueue)
+            return _publishQueue->push(filters[1].second, ev);
+        return sendEvent(ev);
+    }
+    catch (...) {
+        std::cerr << "send failure\n";
+        return false;
+    }
+}
+
+// to the channel, directly or through the batcher; called by
+// publishers, or by the publish queue's thread with 'asyncPublish'
+//
+bool cc::CorbaCommImpl::sendEvent(const CosN::StructuredEvent& ev) const
+{
+    try {
+        if (_batcher)
+            return _batcher->push(ev);
+        _pushSupplier->push(ev);
+        return true;
+    }
+    catch (...) {
+        std::cerr << "send failure\n";
+        return false;
+    }
+}
+
+cc::DispatchStats cc::CorbaCommImpl::dispatchStats() const
+{
+    if (!_executor)
+        return { 0, 0, 0, 0 };
+    auto stats = _executor->stats();
+    return { stats.queued, stats.done, stats.latencyUs, stats.maxLatencyUs };
+}
+
+bool cc::CorbaCommImpl::flushEvents() const
+{
+    if (_publishQueue)
+        _publishQueue->flush();
+    return _batcher ? _batcher->flush() : true;
+}
+
+cc::PublishStats cc::CorbaCommImpl::publishStats() const
+{
+    if (!_publishQueue)
+        return { 0, 0, 0, 0 };
+    return _publishQueue->stats();
+}
+
+// the topic's priority and expiry, in the variable header
+// (TimeBase::TimeT is in 100ns units)
+//
+void cc::CorbaCommImpl::topicHeader(CosN::StructuredEvent& ev,
+                                    const std::string& topic) const
+{
+    auto table = std::atomic_load(&_topicQoS);
+    auto which = table->find(topic);
+    if (which == table->end())
+        return;
+
+    const cc::TopicQoS& qos = which->second;
+    CORBA::ULong        n   = 0;
+    ev.header.variable_header.length(2);
+    if (0 != qos.priority) {
+        ev.header.variable_header[n].name    = CosN::Priority;
+        ev.header.variable_header[n].value <<= (CORBA::Short)qos.priority;
+        ++n;
+    }
+    if (0 != qos.timeoutMs) {
+        ev.header.variable_header[n].name    = CosN::Timeout;
+        ev.header.variable_header[n].value <<= 
+        (TimeBase::TimeT)qos.timeoutMs * 10000;
+        ++n;
+    }
+    ev.header.variable_header.length(n);
+}
+
+void cc::CorbaCommImpl::setTopicQoS(const char* topic, 
+                                    const cc::TopicQoS& qos)
+{
+    if (nullptr == topic || '\0' == *topic)
+        return;
+
+    std::lock_guard<std::mutex> lock(_topicQoSMutex);
+    auto copy = std::make_shared<std::map<std::string, cc::TopicQoS>>(
+                *std::atomic_load(&_topicQoS));
+    if (0 == qos.priority && 0 == qos.timeoutMs)
+        copy->erase(topic);
+    else
+        (*copy)[topic] = qos;
+    std::atomic_store(&_topicQoS, TopicQoSSnapshot(std::move(copy)));
+}
+
+// the channel is shared by every host, the last one to set wins
+//
+bool cc::CorbaCommImpl::setChannelQoS(const cc::ChannelQoS& qos)
+{
+    CosN::QoSProperties   qosProp;
+    CosN::AdminProperties adminProp;
+    if (!channelProperties(qos, qosProp, adminProp))
+        return false;
+
+    CosNCA::EventChannel_ptr channel = getOrCreateChannel(_channelName);
+    if (CORBA::is_nil(channel))
+        return false;
+
+    try {
+        if (qosProp.length() > 0)
+            channel->set_qos(qosProp);
+        if (adminProp.length() > 0)
+            channel->set_admin(adminProp);
+        return true;
+    }
+    catch (CosN::UnsupportedQoS&) {
+        std::cerr << "Unsupported channel QoS\n";
+    }
+    catch (CosN::UnsupportedAdmin&) {
+        std::cerr << "Unsupported channel admin properties\n";
+    }
+    catch (...) {
+        std::cerr << "Can't set channel QoS\n";
+    }
+    return false;
+}
+
+// false if 'qos' has a policy the channel would reject, it's left
+// out (the channel's default applies) and reported
+//
+// static
+bool cc::CorbaCommImpl::channelProperties(const cc::ChannelQoS&  qos,
+                                          CosN::QoSProperties&   qosProp,
+                                          CosN::AdminProperties& adminProp)
+{
+    bool valid = true;
+
+    auto policy = [](cc::QueuePolicy p) -> CORBA::Short {
+        switch (p) {
+        case cc::QueuePolicy::fifo:     return CosN::FifoOrder;
+        case cc::QueuePolicy::lifo:     return CosN::LifoOrder;
+        case cc::QueuePolicy::priority: return CosN::PriorityOrder;
+        case cc::QueuePolicy::deadline: return CosN::DeadlineOrder;
+        default:                        return CosN::AnyOrder;
+        }
+    };
+
+    // there's no LIFO order (CosNotification's LifoOrder is a discard
+    // policy), the channel rejects it
+    //
+    CORBA::ULong n = 0;
+    qosProp.length(4);
+    if (cc::QueuePolicy::lifo == qos.orderPolicy) {
+        std::cerr << "QueuePolicy::lifo isn't an order policy\n";
+        valid = false;
+    }
+    else if (cc::QueuePolicy::channelDefault != qos.orderPolicy) {
+        qosProp[n].name    = CosN::OrderPolicy;
+        qosProp[n].value <<= policy(qos.orderPolicy);
+        ++n;
+    }
+    if (cc::QueuePolicy::channelDefault != qos.discardPolicy) {
+        qosProp[n].name    = CosN::DiscardPolicy;
+        qosProp[n].value <<= policy(qos.discardPolicy);
+        ++n;
+    }
+    if (0 != qos.maxEventsPerConsumer) {
+        qosProp[n].name    = CosN::MaxEventsPerConsumer;
+        qosProp[n].value <<= (CORBA::Long)qos.maxEventsPerConsumer;
+        ++n;
+    }
+    if (0 != qos.timeoutMs) {
+        qosProp[n].name    = CosN::Timeout;
+        qosProp[n].value <<= (TimeBase::TimeT)qos.timeoutMs * 10000;
+        ++n;
+    }
+    qosProp.length(n);
+
+    adminProp.length(0);
+    if (0 != qos.maxQueueLength) {
+        adminProp.length(1);
+        adminProp[0].name    = CosN::MaxQueueLength;
+        adminProp[0].value <<= (CORBA::Long)qos.maxQueueLength;
+    }
+    return valid;
+}
+
+std::string cc::CorbaCommImpl::execCmd(const char* cmd,
+                                      const char* param)
+{
+    return execCmdById(internCmd(cmd), param);
+}
+
+std::string cc::CorbaCommImpl::execCmdById(cc::CmdId id,
+                                          const char* param)
+{
+    // serve a cacheable command from the cache if possible
+    //
+    auto     table = routing();
+    unsigned ttlMs = id >= 0 && (size_t)id < table->routes.size() ?
+                     table->routes[id].cacheTtlMs : 0;
+    table.reset();
+    if (0 == ttlMs)
+        return invokeCmd(id, param);
+
+    std::string key(param);
+    std::string result;
+    if (_cache->get(id, key, result))
+        return result;
+
+    result = invokeCmd(id, param);
+    if (!result.empty())
+        _cache->put(id, key, result, std::chrono::milliseconds(ttlMs));
+    return result;
+}
+
+bool cc::CorbaCommImpl::postCmd(const char* cmd, const char* param)
+{
+    RoutingSnapshot table;
+    const Route*    route = lookupRoute(internCmd(cmd), table);
+    if (nullptr == route)
+        return false;
+
+    if (route->localCmdId >= 0) {
+        _providerImpl->callLocal(route->localCmdId, route->cmd.c_str(),
+                                 param, std::strlen(param));
+        return true;
+    }
+
+    const Replica& replica = balance(*route);
+    ProviderRef::Handle providerRef = 
+    getObjReference(replica.provider, route->compression);
+    if (!providerRef)
+        return false;
+
+    // counted before it's sent, a flush may already wait for it
+    //
+    Load&    load = *replica.load;
+    uint64_t epoch;
+    {
+        std::lock_guard<std::mutex> lock(load.postMutex);
+        epoch = load.epoch;
+        ++load.posted;
+    }
+
+    try {
+        providerRef->postCmd(replica.cmdId, route->cmd.c_str(), param, 
+                             _hostId.c_str(), epoch);
+        return true;
+    }
+    catch (...) {
+        // can't reach target host (maybe host is down)
+        //
+        {
+            std::lock_guard<std::mutex> lock(load.postMutex);
+            if (load.epoch == epoch)
+                --load.posted;
+        }
+        dropProvider(replica.provider);
+        return false;
+    }
+}
+
+// asks every provider posted to, to confirm it has processed as many
+// commands as this host has posted to its epoch
+//
+// commands posted to a provider which restarted (another epoch) or
+// can't be reached are lost, or their fate is unknown: the flush is
+// false, and they're written off; a flush settles the commands of a
+// dropped provider, then its load is dropped, too
+//
+bool cc::CorbaCommImpl::flushCmds(unsigned timeoutMs)
+{
+    auto table   = routing();
+    bool flushed = true;
+    bool settled = false;
+    for (const auto& which : table->loads) {
+        Load&    load = *which.second;
+        uint64_t posted;
+        uint64_t epoch;
+        {
+            std::lock_guard<std::mutex> lock(load.postMutex);
+            if (load.posted == load.settled)
+                continue;
+            posted = load.posted;
+            epoch  = load.epoch;
+        }
+
+        CORBA::ULongLong current   = epoch;
+        uint64_t         processed = 0;
+        bool             reached   = false;
+        ProviderRef::Handle providerRef = getObjReference(which.first);
+        if (providerRef) {
+            try {
+                processed = 
+                providerRef->waitProcessed(_hostId.c_str(), posted, 
+                                           timeoutMs, current);
+                reached   = true;
+            }
+            catch (...) {
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(load.postMutex);
+        if (load.epoch != epoch)
+            continue;       // written off by another flush
+
+        // the provider counts commands posted to an unknown epoch, too
+        //
+        if (0 == epoch && reached)
+            epoch = load.epoch = current;
+        if (!reached || current != epoch) {
+            load.epoch   = reached ? current : epoch;
+            load.posted  = load.settled = 0;
+            flushed      = false;
+            settled      = true;
+        }
+        else if (processed < posted)
+            flushed = false;
+        else {
+            load.settled = std::max(load.settled, posted);
+            settled      = true;
+        }
+    }
+
+    // loads of dropped providers which are settled now
+    //
+    if (settled) {
+        updateRouting([&](RoutingTable& next) {
+            for (auto which = next.loads.begin(); 
+                 which != next.loads.end(); ) {
+                if (!routed(next, which->first) && settledLoad(*which->second))
+                    which = next.loads.erase(which);
+                else
+                    ++which;
+            }
+        });
+    }
+    return flushed;
+}
+
+void cc::CorbaCommImpl::cacheCmd(const char* cmd, unsigned ttlMs)
+{
+    updateRouting([&](RoutingTable& table) {
+        table.routes[internCmd(table, cmd)].cacheTtlMs = ttlMs;
+    });
+}
+
+cc::CacheStats cc::CorbaCommImpl::cacheStats() const
+{
+    return _cache->stats();
+}
+
+void cc::CorbaCommImpl::setCallPolicy(const char* cmd, 
+                                      const cc::CallPolicy& policy)
+{
+    if (policy.hedge) {
+        std::call_once(_hedgerOnce, [this]() {
+            _hedger = std::make_unique<cc::Dispatcher>(
+                          _options.hedgeThreads, 
+                          std::max(1u, _options.hedgeThreads));
+        });
+    }
+    updateRouting([&](RoutingTable& table) {
+        table.routes[internCmd(table, cmd)].policy = policy;
+    });
+}
+
+cc::HedgeStats cc::CorbaCommImpl::hedgeStats() const
+{
+    return { _hedgesSent.load(), _hedgesWon.load() };
+}
+
+std::string cc::CorbaCommImpl::invokeCmd(cc::CmdId id, const char* param)
+{
+    RoutingSnapshot table;
+    const Route*    route = lookupRoute(id, table);
+    if (nullptr == route)
+        return "";
+
+    // co-located provider, no ORB, no marshalling
+    //
+    if (route->localCmdId >= 0)
+        return _providerImpl->callLocal(route->localCmdId, 
+                                        route->cmd.c_str(),
+                                        param, std::strlen(param));
+
+    // hedging needs a second provider and the command's latency
+    //
+    if (route->policy.hedge && route->replicas.size() > 1 &&
+        route->latency->p95() > 0)
+        return invokeHedged(table, *route, param);
+
+    std::string result;
+    callProvider(*route, balance(*route), param, result);
+    return result;
+}
+
+namespace {
+
+// a per-call deadline, it applies to the calling thread's calls only
+//
+class CallTimeout {
+public:
+    explicit CallTimeout(unsigned ms) : _ms{ms} {
+        if (_ms > 0)
+            omniORB::setClientThreadCallTimeout(_ms);
+    }
+    ~CallTimeout() {
+        if (_ms > 0)
+            omniORB::setClientThreadCallTimeout(0);
+    }
+private:
+    unsigned _ms;
+};
+
+}   // namespace
+
+// returns false if the provider doesn't answer
+//
+bool cc::CorbaCommImpl::callProvider(const Route& route, 
+                                     const Replica& replica,
+                                     const char* param, std::string& result)
+{
+    ProviderRef::Handle providerRef = 
+    getObjReference(replica.provider, route.compression);
+    if (!providerRef)
+        return false;
+
+    Call call(replica);
+    if (ShmClient* shm = providerRef.shm()) {
+        auto status = shm->call(false, replica.cmdId, route.cmd.c_str(),
+                                param, std::strlen(param), 
+                                route.policy.timeoutMs, result);
+        if (ShmClient::done == status)
+            route.latency->record(call.done());
+
+        // like CORBA, a provider which times out or sheds the request
+        // is busy, not gone
+        //
+        if (ShmClient::gone == status)
+            dropProvider(replica.provider);
+        if (ShmClient::unsent != status)
+            return ShmClient::done == status;
+    }
+
+    CallTimeout timeout(route.policy.timeoutMs);
+    try {
+        CORBA::String_var ret;
+
+        // with provider's id, the provider dispatches by array index
+        //
+        if (replica.cmdId >= 0)
+            ret = providerRef->execCmdById(replica.cmdId, 
+                                           route.cmd.c_str(), param);
+        else
+            ret = providerRef->execCmd(route.cmd.c_str(), param);
+
+        route.latency->record(call.done());
+        result = (const char*)ret;
+        return true;
+    }
+    catch (CORBA::NO_RESOURCES&) {
+        // the provider shed the request, it's busy, not gone
+        //
+        return false;
+    }
+    catch (CORBA::TRANSIENT& ex) {
+        // a provider which times out is slow, not gone
+        //
+        if (ex.minor() != omni::TRANSIENT_CallTimedout)
+            dropProvider(replica.provider);
+        return false;
+    }
+    catch (... ) {
+        // can't reach target host (maybe host is down)
+        //
+        dropProvider(replica.provider);
+        return false;
+    }
+}
+
+// the request is sent to a provider by a hedger thread; if it isn't
+// answered within the command's 95th percentile latency (or it fails),
+// the calling thread sends it to the next provider itself, so a hedge
+// never waits behind slow requests queued on the hedgers; the first
+// answer wins, the loser's answer is dropped when it comes
+//
+// a request still queued when the hedge answers is never sent, and a
+// call which finds the hedgers' queue full isn't hedged, the calling
+// thread sends it; the command's budget bounds the hedges sent
+//
+std::string cc::CorbaCommImpl::invokeHedged(const RoutingSnapshot& table,
+                                            const Route& route,
+                                            const char* param)
+{
+    struct Hedge {
+        std::mutex              mutex;
+        std::condition_variable cv;
+        std::string             result;
+        unsigned                pending  = 0;
+        bool                    answered = false;
+    };
+    auto hedge = std::make_shared<Hedge>();
+
+    const auto&    replicas = route.replicas;
+    const Replica& first    = balance(route);
+    const Replica& second   = 
+    replicas[(&first - replicas.data() + 1) % replicas.size()];
+
+    // 'table' keeps 'route' and the replicas alive for the task
+    //
+    const Route*   routeOf   = &route;
+    const Replica* replicaOf = &first;
+    std::string    text(param);
+    auto settled = [&hedge]() { 
+        return hedge->answered || 0 == hedge->pending; 
+    };
+
+    route.latency->called();
+    std::unique_lock<std::mutex> lock(hedge->mutex);
+    ++hedge->pending;
+    bool queued = 
+    _hedger->tryPost([this, table, hedge, routeOf, replicaOf, text]() {
+        {
+            std::lock_guard<std::mutex> lock(hedge->mutex);
+            if (hedge->answered) {
+                --hedge->pending;
+                hedge->cv.notify_all();
+                return;
+            }
+        }
+        std::string result;
+        bool ok = callProvider(*routeOf, *replicaOf, text.c_str(), result);
+
+        std::lock_guard<std::mutex> lock(hedge->mutex);
+        --hedge->pending;
+        if (ok && !hedge->answered) {
+            hedge->answered = true;
+            hedge->result   = std::move(result);
+        }
+        hedge->cv.notify_all();
+    });
+    if (!queued) {
+        lock.unlock();
+        std::string result;
+        callProvider(route, first, param, result);
+        return result;
+    }
+
+    auto threshold = std::chrono::microseconds(route.latency->p95());
+    hedge->cv.wait_for(lock, threshold, settled);
+
+    // a failed request is retried regardless of the budget
+    //
+    if (!hedge->answered && 
+        (0 == hedge->pending || 
+         route.latency->hedge(route.policy.hedgeBudget))) {
+        ++_hedgesSent;
+        lock.unlock();
+        std::string result;
+        bool ok = callProvider(route, second, param, result);
+        lock.lock();
+        if (ok && !hedge->answered) {
+            hedge->answered = true;
+            hedge->result   = std::move(result);
+            ++_hedgesWon;
+        }
+    }
+    hedge->cv.wait(lock, settled);
+    return hedge->result;
+}
+
+std::string cc::CorbaCommImpl::execBinCmd(const char* cmd,
+                                          const void* data,
+                                          size_t      length)
+{
+    std::string result;
+    execBinCmd(cmd, data, length, result);
+    return result;
+}
+
+// 'result' is empty unless it's done
+//
+cc::CmdStatus cc::CorbaCommImpl::execBinCmd(const char*  cmd,
+                                            const void*  data,
+                                            size_t       length,
+                                            std::string& result)
+{
+    result.clear();
+
+    RoutingSnapshot table;
+    const Route*    route = lookupRoute(internCmd(cmd), table);
+    if (nullptr == route)
+        return CmdStatus::unrouted;
+
+    if (route->localCmdId >= 0) {
+        result = _providerImpl->callLocalBin(route->localCmdId, cmd, 
+                                             (const char*)data, length);
+        return CmdStatus::done;
+    }
+
+    const Replica& replica = balance(*route);
+    ProviderRef::Handle providerRef = 
+    getObjReference(replica.provider, route->compression);
+    if (!providerRef)
+        return CmdStatus::failed;
+
+    Call call(replica);
+    if (ShmClient* shm = providerRef.shm()) {
+        auto status = shm->call(true, replica.cmdId, cmd, 
+                                (const char*)data, length,
+                                route->policy.timeoutMs, result);
+        switch (status) {
+        case ShmClient::done:
+            route->latency->record(call.done());
+            return CmdStatus::done;
+        case ShmClient::overloaded:
+            return CmdStatus::overloaded;
+        case ShmClient::gone:
+            dropProvider(replica.provider);
+            return CmdStatus::failed;
+        case ShmClient::timedOut:
+            return CmdStatus::failed;
+        default:
+            break;
+        }
+    }
+
+    // borrow caller's buffer, no copy
+    //
+    CorbaCommModule::Octets param(length, length, (CORBA::Octet*)data, false);
+    CallTimeout timeout(route->policy.timeoutMs);
+    try {
+        CorbaCommModule::Octets_var ret;
+        ret = providerRef->execBinCmd(cmd, param);
+
+        route->latency->record(call.done());
+        result.assign((const char*)ret->get_buffer(), ret->length());
+        return CmdStatus::done;
+    }
+    catch (CORBA::NO_RESOURCES&) {
+        // the provider shed the request, it's busy, not gone
+        //
+        return CmdStatus::overloaded;
+    }
+    catch (CORBA::TRANSIENT& ex) {
+        // a provider which times out is slow, not gone
+        //
+        if (ex.minor() != omni::TRANSIENT_CallTimedout)
+            dropProvider(replica.provider);
+        return CmdStatus::failed;
+    }
+    catch (... ) {
+        // can't reach target host (maybe host is down)
+        //
+        dropProvider(replica.provider);
+        return CmdStatus::failed;
+    }
+}
+
+cc::Results cc::CorbaCommImpl::execBatch(const cc::CmdRequests& requests)
+{
+    cc::Results results(requests.size());
+
+    // one round trip per provider (and compression policy, a command's
+    // policy is the reference's), remember where each result goes
+    //
+    std::map<std::pair<std::string, size_t>, std::vector<size_t>> batches;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        RoutingSnapshot table;
+        const Route*    route = 
+        lookupRoute(internCmd(requests[i].first.c_str()), table);
+        if (nullptr == route)
+            continue;
+
+        // co-located commands are called right here
+        //
+        if (route->localCmdId >= 0)
+            results[i] = 
+            _providerImpl->callLocal(route->localCmdId, route->cmd.c_str(),
+                                     requests[i].second.data(),
+                                     requests[i].second.size());
+        else
+            batches[{balance(*route).provider, route->compression}]
+                   .push_back(i);
+    }
+
+    for (const auto& batch : batches) {
+        const auto& provider = batch.first.first;
+        const auto& indexes  = batch.second;
+
+        ProviderRef::Handle providerRef = 
+        getObjReference(provider, batch.first.second);
+        if (!providerRef)
+            continue;
+
+        CorbaCommModule::CommandSeq cmds;
+        cmds.length(indexes.size());
+        for (CORBA::ULong i = 0; i < indexes.size(); ++i) {
+            cmds[i].cmd   = requests[indexes[i]].first.c_str();
+            cmds[i].param = requests[indexes[i]].second.c_str();
+        }
+
+        try {
+            CorbaCommModule::ResultSeq_var ret;
+            ret = providerRef->execBatch(cmds);
+
+            CORBA::ULong n = std::min<CORBA::ULong>(ret->length(), 
+                                                    indexes.size());
+            for (CORBA::ULong i = 0; i < n; ++i)
+                results[indexes[i]] = (const char*)ret[i];
+        }
+        catch (...) {
+            // can't reach target host (maybe host is down)
+            //
+            dropProvider(provider);
+        }
+    }
+    return results;
+}
+
+cc::CmdId cc::CorbaCommImpl::internCmd(const char* cmd)
+{
+    auto table = routing();
+    auto which = table->wantCommands.find(cmd);
+    if (which != table->wantCommands.end())
+        return which->second;
+
+    cc::CmdId id;
+    updateRouting([&](RoutingTable& next) {
+        id = internCmd(next, cmd);
+    });
+    return id;
+}
+
+// the index of the command's compression override in '_compression',
+// 0 (the policy for every command) if it has none
+//
+size_t cc::CorbaCommImpl::compressionOf(const std::string& cmd) const
+{
+    auto override = _options.cmdCompression.find(cmd);
+    if (override == _options.cmdCompression.end())
+        return 0;
+    return 1 + std::distance(_options.cmdCompression.begin(), override);
+}
+
+cc::CmdId cc::CorbaCommImpl::internCmd(RoutingTable& table, 
+                                       const char* cmd) const
+{
+    auto which = table.wantCommands.find(cmd);
+    if (which != table.wantCommands.end())
+        return which->second;
+
+    size_t    compression = compressionOf(cmd);
+    cc::CmdId id          = table.routes.size();
+    table.wantCommands.emplace(cmd, id);
+    // a command this host provides is routed right away
+    //
+    CORBA::Long localCmdId = 
+    nullptr != _providerImpl.in() ? _providerImpl->provides(cmd) : -1;
+
+    table.routes.push_back({
+        cmd, {}, localCmdId, std::make_shared<std::atomic<unsigned>>(0), 
+        compression, 0, cc::CallPolicy(), std::make_shared<Latency>()
+    });
+    return id;
+}
+
+// returns the command's route, which lives as long as 'table' is held,
+// or nullptr if the command can't be routed
+//
+const cc::CorbaCommImpl::Route* 
+cc::CorbaCommImpl::lookupRoute(cc::CmdId id, RoutingSnapshot& table)
+{
+    using namespace std::chrono;
+
+    // lookup who is provider
+    //
+    table = routing();
+    if (id < 0 || (size_t)id >= table->routes.size())
+        return nullptr;
+    if (!table->routes[id].replicas.empty() || 
+        table->routes[id].localCmdId >= 0)
+        return &table->routes[id];
+
+    // late command routing
+    // the routing table is re-checked with 'sync' locked, and it's
+    // updated before 'unblockedCmd()' locks 'sync', no wakeup is lost
+    //
+    const std::string cmd = table->routes[id].cmd;
+    const auto deadline = steady_clock::now() + 
+                          milliseconds(_options.routingTimeoutMs);
+    SyncObj& sync = syncObject(cmd.c_str());
+    std::unique_lock<std::mutex> lock(*sync._mutex);
+    ++sync._waiters;
+
+    const Route* route = nullptr;
+    while (true) {
+        table = routing();
+        if (!table->routes[id].replicas.empty() ||
+            table->routes[id].localCmdId >= 0) {
+            route = &table->routes[id];
+            break;
+        }
+
+        auto now = steady_clock::now();
+        if (now >= deadline)
+            break;
+
+        if (now >= sync._retryAt) {
+            // no query in flight (or it's unanswered for too long),
+            // this caller publishes one on behalf of all waiters
+            //
+            // at least 1ms apart, even with 0 'routingRetryMs',
+            // and at most 'maxRoutingBackoffMs'
+            //
+            if (sync._backoff == milliseconds::zero())
+                sync._backoff = 
+                milliseconds(std::max(1u, _options.routingRetryMs));
+            else
+                sync._backoff = std::min(sync._backoff * 2, 
+                                         milliseconds(maxRoutingBackoffMs));
+            sync._retryAt = now + sync._backoff;
+
+            lock.unlock();
+            publishWantCommands({cmd});
+            lock.lock();
+            continue;
+        }
+        sync._cv->wait_until(lock, std::min(deadline, sync._retryAt));
+    }
+
+    // the last waiter leaves, the next lookup starts afresh
+    //
+    if (0 == --sync._waiters) {
+        sync._retryAt = steady_clock::time_point::min();
+        sync._backoff = milliseconds::zero();
+    }
+    return route;
+}
+
+// picks one of the command's providers by 'balancePolicy'
+// the loads are read racily, a near-best pick is good enough
+//
+const cc::CorbaCommImpl::Replica& 
+cc::CorbaCommImpl::balance(const Route& route) const
+{
+    const auto& replicas = route.replicas;
+    if (1 == replicas.size())
+        return replicas[0];
+
+    unsigned first = route.next->fetch_add(1, std::memory_order_relaxed);
+    switch (_options.balancePolicy) {
+    case BalancePolicy::leastOutstanding: {
+        size_t   best  = first % replicas.size();
+        unsigned least = replicas[best].load->outstanding.load();
+        for (size_t i = 1; i < replicas.size() && least > 0; ++i) {
+            size_t   which = (first + i) % replicas.size();
+            unsigned n     = replicas[which].load->outstanding.load();
+            if (n < least) {
+                best  = which;
+                least = n;
+            }
+        }
+        return replicas[best];
+    }
+    case BalancePolicy::powerOfTwo: {
+        // two random (distinct) picks, the one whose latency, 
+        // scaled by its calls in flight, is lower wins
+        // a provider not called yet has no latency, it's taken to be
+        // as fast as the other pick, so its calls in flight decide
+        // rather than it winning every pick
+        //
+        static thread_local std::minstd_rand random(
+            std::hash<std::thread::id>()(std::this_thread::get_id()));
+        size_t a = random() % replicas.size();
+        size_t b = (a + 1 + random() % (replicas.size() - 1)) % 
+                   replicas.size();
+        uint64_t latencyA = replicas[a].load->latencyUs.load();
+        uint64_t latencyB = replicas[b].load->latencyUs.load();
+        if (0 == latencyA)
+            latencyA = 0 == latencyB ? 1 : latencyB;
+        if (0 == latencyB)
+            latencyB = latencyA;
+        uint64_t costA = latencyA * (1 + replicas[a].load->outstanding.load());
+        uint64_t costB = latencyB * (1 + replicas[b].load->outstanding.load());
+        return costA <= costB ? replicas[a] : replicas[b];
+    }
+    case BalancePolicy::roundRobin:
+    default:
+        return replicas[first % replicas.size()];
+    }
+}
+
+cc::CorbaCommImpl::Call::Call(const Replica& replica)
+                       : _load{replica.load.get()}
+                       , _start{std::chrono::steady_clock::now()}
+{
+    _load->outstanding.fetch_add(1, std::memory_order_relaxed);
+}
+
+cc::CorbaCommImpl::Call::~Call()
+{
+    _load->outstanding.fetch_sub(1, std::memory_order_relaxed);
+}
+
+// the latency's moving average, a new sample weighs 1/8
+//
+uint64_t cc::CorbaCommImpl::Call::done()
+{
+    using namespace std::chrono;
+    uint64_t sample = 
+    duration_cast<microseconds>(steady_clock::now() - _start).count();
+    uint64_t average = _load->latencyUs.load(std::memory_order_relaxed);
+    average = 0 == average ? sample : average - average / 8 + sample / 8;
+    _load->latencyUs.store(average, std::memory_order_relaxed);
+    return sample;
+}
+
+void cc::CorbaCommImpl::Latency::record(uint64_t us)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _samples[_count++ % _samples.size()] = us;
+    if (0 != _count % 16)
+        return;
+
+    std::array<uint64_t, 128> sorted = _samples;
+    size_t n   = std::min(_count, sorted.size());
+    auto   p95 = sorted.begin() + n * 95 / 100;
+    std::nth_element(sorted.begin(), p95, sorted.begin() + n);
+    _p95.store(*p95, std::memory_order_relaxed);
+}
+
+void cc::CorbaCommImpl::Latency::called()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (++_calls > 128) {
+        _calls  = 1;
+        _hedges = 0;
     }
 }
 
-cc::SID cc::CorbaCommImpl::onEvent(const char* topic,
-                                   cc::EventCallback_t callback) 
+bool cc::CorbaCommImpl::Latency::hedge(unsigned budget)
 {
-    if (nullptr == topic|| 0 == std::strcmp(topic,""))
-        return "";
-    bool ok = false;
-    auto which = _subscribeMap.find(topic);
-    if (which == _subscribeMap.end()) {
-        _subscribeMap[topic] = {callback};
-        ok = true;
-    }
-    else {
-        auto all = which->second;
-        auto itr = std::find(std::begin(all), std::end(all), callback);
-        if (itr == std::end(all)) {
-            which->second.push_back(callback);
-            ok = true;
+    std::lock_guard<std::mutex> lock(_mutex);
+    if ((_hedges + 1) * 100 > _calls * budget)
+        return false;
+    ++_hedges;
+    return true;
+}
+
+cc::ProviderRef::Handle
+cc::CorbaCommImpl::getObjReference(const std::string& provider,
+                                   size_t compression)
+{
+    // lookup Provider's references
+    //
+    auto table = routing();
+    auto which = table->objRefMap.find(provider);
+    if (which != table->objRefMap.end())
+        return ProviderRef::hold(which->second[compression]);
+
+    CosNaming::Name name;
+    name.length(2);
+    name[0].id   = "edwardlintw";
+    name[0].kind = "com";
+    name[1].id   = provider.c_str();
+    name[1].kind = "provider";
+
+    CORBA::Object_var obj          = resolveObjectReference(name);
+    CorbaCommModule::Provider_var  providerRef  = 
+    CorbaCommModule::Provider::_narrow(obj);
+    if (CORBA::is_nil(providerRef))
+        return ProviderRef::Handle();
+
+    // a provider on the same host is reached through shared memory,
+    // a provider which doesn't know 'sharedMemory()' is an old one
+    //
+    std::shared_ptr<ShmClient> shm;
+    if (_options.sharedMemory) {
+        try {
+            CORBA::String_var segment = providerRef->sharedMemory();
+            if ('\0' != segment.in()[0])
+                shm = ShmClient::open(segment.in());
+        }
+        catch (...) {
         }
     }
-    if (ok) {
-        auto sid = genSID();
-        _evtInfoMap[sid] = {topic, callback};
-        return sid;
-    }
-    else {
-        return "";
+
+    // the global policies apply to the default reference, a per-command
+    // compression override gets an overridden reference
+    //
+    ProviderRefs refs;
+    refs.push_back(std::make_shared<ProviderRef>(providerRef, shm));
+    for (size_t i = 1; i < _compression.size(); ++i) {
+        CORBA::PolicyList pl = compressionPolicies(_compression[i]);
+        obj = providerRef->_set_policy_overrides(pl, CORBA::ADD_OVERRIDE);
+        refs.push_back(std::make_shared<ProviderRef>(
+                            CorbaCommModule::Provider::_narrow(obj), shm));
     }
+
+    updateRouting([&](RoutingTable& table) {
+        table.objRefMap[provider] = refs;
+    });
+    return ProviderRef::hold(refs[compression]);
 }
 
-void cc::CorbaCommImpl::detachEvent(const SID& sid)
+cc::CorbaCommImpl::RoutingSnapshot cc::CorbaCommImpl::routing() const
 {
-    auto evtInfoItr = _evtInfoMap.find(sid);
-    if (evtInfoItr != _evtInfoMap.end()) {
-        auto topic= evtInfoItr->second.first;
-        auto callback = evtInfoItr->second.second;
-        auto which = _subscribeMap.find(topic);
-        if (which != _subscribeMap.end()) {
-            auto& callbacks = which->second;
-            which->second.erase(
-            std::remove(std::begin(callbacks), std::end(callbacks), callback));
-        } 
-        _evtInfoMap.erase(evtInfoItr);
-    }
+    return std::atomic_load(&_routing);
 }
 
-bool cc::CorbaCommImpl::pushEvent(const char* topic, 
-                                  const char* param) const
+template <typename Modifier>
+void cc::CorbaCommImpl::updateRouting(Modifier modify)
 {
-    cc::CorbaCommImpl::Filters filters = {{
-        std::make_pair(std::string("sender"),  _hostId),
-        std::make_pair(std::string("command"), std::string(topic))
-    }};
-    // bridge to the other overloading 'pushEvent'
-    //
-    return pushEvent(topic, param, filters);
+    std::lock_guard<std::mutex> lock(_routingMutex);
+    auto table = std::make_shared<RoutingTable>(*std::atomic_load(&_routing));
+    modify(*table);
+    std::atomic_store(&_routing, RoutingSnapshot(table));
 }
 
-bool cc::CorbaCommImpl::pushEvent(
-                           const char* topic, 
-                           const char* param,
-                           const cc::CorbaCommImpl::Filters& filters) const
+std::future<cc::CmdResult> cc::CorbaCommImpl::execCmdAsync(const char* cmd,
+                                                           const char* param)
 {
-    CosN::StructuredEvent* ev = new CosN::StructuredEvent;
-    try {
-
-        // setup event header (for filtering)
-        //
-        ev->header.fixed_header.event_type.domain_name = "";
-        ev->header.fixed_header.event_type.type_name   = "";
-        ev->header.variable_header.length(0);
-        ev->filterable_data.length(filters.size());
-        size_t  i = 0;
-        for (const auto& filter : filters) {
-            ev->filterable_data[i].name    = filter.first.c_str();
-            ev->filterable_data[i].value <<= filter.second.c_str();
-            ++i;
-        }
-
-        ev->remainder_of_body <<= param;
-        _pushSupplier->push(*ev);
-
-        delete ev;
-        return true;
-    }
-    catch (...) {
-        std::cerr << "send failure\n";
-        delete ev;
-        return false;
-    }
+    auto promise = std::make_shared<std::promise<CmdResult>>();
+    auto future  = promise->get_future();
+    sendAsync(cmd, param, [promise](const CmdResult& result) {
+        promise->set_value(result);
+    });
+    return future;
 }
 
-std::string cc::CorbaCommImpl::execCmd(const char* cmd,
-                                      const char* param)
+void cc::CorbaCommImpl::execCmdAsync(const char* cmd,
+                                     const char* param,
+                                     cc::CompletionCallback_t callback)
 {
-    // lookup who is provider
-    //
-re_run:
-    auto whois = _providerInfoMap.find(cmd);
-    if (whois == _providerInfoMap.end()) {
-        _wantCommands.push_back(cmd);
+    sendAsync(cmd, param, [callback, command = std::string(cmd)](
+                          const CmdResult& result) {
+        if (nullptr != callback)
+            (*callback)(command, result);
+    });
+}
 
-        auto itr = _syncMap.find(cmd);
-        if (itr == _syncMap.end()) {
-            _syncMap[cmd] = SyncObj();
-            itr = _syncMap.find(cmd);
-        }
+// the request is sent by AMI ('sendc_'), 'complete' is called by the
+// ORB thread which gets the reply; a request which isn't sent is
+// completed right here
+//
+void cc::CorbaCommImpl::sendAsync(const char* cmd, const char* param,
+                                  std::function<void(const CmdResult&)> 
+                                  complete)
+{
+    CmdId           id = internCmd(cmd);
+    RoutingSnapshot table;
+    const Route*    route = lookupRoute(id, table);
+    if (nullptr == route) {
+        complete({CmdStatus::unrouted, ""});
+        return;
+    }
+    if (route->localCmdId >= 0) {
+        complete({CmdStatus::done, 
+                  _providerImpl->callLocal(route->localCmdId, 
+                                           route->cmd.c_str(),
+                                           param, std::strlen(param))});
+        return;
+    }
 
-        std::unique_lock<std::mutex>    lock(*itr->second._mutex);
-        itr->second._cmdReady = false;
+    std::string key(param);
+    std::string cached;
+    unsigned    ttlMs = route->cacheTtlMs;
+    if (0 != ttlMs && _cache->get(id, key, cached)) {
+        complete({CmdStatus::done, cached});
+        return;
+    }
 
-        std::thread ([this,cmd]() {
-                        publishWantCommands({cmd}); 
-                    }).detach();
+    if (_asyncInFlight.fetch_add(1) >= _options.asyncInFlight && 
+        0 != _options.asyncInFlight) {
+        asyncDone();
+        complete({CmdStatus::overloaded, ""});
+        return;
+    }
 
-        using namespace std::chrono_literals;
-        itr->second._cv->wait_for(lock, 100ms, 
-                                  [this,itr]() { 
-                                      return itr->second._cmdReady; 
-                                  });
-        if (false == itr->second._cmdReady)
-            return "";
-        else {
-            goto re_run;
-        }
+    const Replica& replica = balance(*route);
+    ProviderRef::Handle providerRef = 
+    getObjReference(replica.provider, route->compression);
+    if (!providerRef) {
+        asyncDone();
+        complete({CmdStatus::failed, ""});
+        return;
     }
 
-    // lookup Provider's Object reference
+    // 'table' keeps 'route' and the replica's load alive for the reply
     //
-    std::string provider = whois->second;
-    auto which = _objRefMap.find(provider);
-    if (which != _objRefMap.end()) {
-        try {
-            CORBA::String_var ret;
-            std::string       result;
-            ret = 
-            which->second->execCmd(cmd, param);
+    auto call  = std::make_shared<Call>(replica);
+    auto reply = new AsyncReply(_poa, 
+        [this, table, route, call, id, key, ttlMs, complete, 
+         provider = replica.provider](CmdStatus status, bool gone,
+                                      const char* result) {
+            if (CmdStatus::done == status) {
+                route->latency->record(call->done());
+                if (0 != ttlMs && '\0' != result[0])
+                    _cache->put(id, key, result, 
+                                std::chrono::milliseconds(ttlMs));
+            }
+            if (gone)
+                dropProvider(provider);
+            complete({status, CmdStatus::done == status ? result : ""});
+            asyncDone();
+        });
 
-            result = (const char*)ret;
-            return result;
-        }
-        catch (... ) {
-            // can't reach target host (maybe host is down)
-            //
-            _objRefMap.erase(which);
-            return "";
-        }
+    CallTimeout timeout(route->policy.timeoutMs);
+    try {
+        CorbaCommModule::AMI_ProviderHandler_var handler = reply->activate();
+        providerRef->sendc_execCmdById(handler, replica.cmdId, 
+                                       route->cmd.c_str(), param);
     }
-    else {
-        CosNaming::Name name;
-        name.length(2);
-        name[0].id   = "edwardlintw";
-        name[0].kind = "com";
-        name[1].id   = provider.c_str();
-        name[1].kind = "provider";
-
-        CORBA::Object_var obj          = resolveObjectReference(name);
-        CorbaCommModule::Provider_ptr  providerRef  = 
-        CorbaCommModule::Provider::_narrow(obj);
+    catch (CORBA::TRANSIENT& ex) {
+        reply->fail(ex.minor() != omni::TRANSIENT_CallTimedout);
+    }
+    catch (...) {
+        reply->fail(true);
+    }
+}
 
-        std::string result;
-        try {
-            CORBA::String_var   ret;
-            ret = providerRef->execCmd(cmd, param);
-            result = (const char*)ret;
-            _objRefMap[provider] = providerRef;
-        }
-        catch (...) {
-            result = "";
-        }
-        return result;
+void cc::CorbaCommImpl::asyncDone()
+{
+    if (1 == _asyncInFlight.fetch_sub(1)) {
+        std::lock_guard<std::mutex> lock(_asyncMutex);
+        _asyncCv.notify_all();
     }
 }
 
 void cc::CorbaCommImpl::onCmd(const char* cmd,
                               cc::CommandCallback_t func) 
 {
-    if (_hostId != cmd 
-        &&
-        std::find(std::begin(_offerCommands), 
-                  std::end(_offerCommands), cmd) == std::end(_offerCommands)
-       ) 
-    {
-        publishOfferCommands({cmd});
-        _offerCommands.push_back(cmd);
-    }
+    offerCommand(cmd);
 
     auto which = _providerMap.find(cmd);
     if (which != _providerMap.end()) {
@@ -420,6 +2042,51 @@ void cc::CorbaCommImpl::onCmd(const char* cmd,
 
     _providerMap[cmd] = func;
     _providerImpl->onCmd(cmd, func);
+    routeLocally(cmd);
+}
+
+void cc::CorbaCommImpl::onBinCmd(const char* cmd,
+                                 cc::BinaryCommandCallback_t func) 
+{
+    offerCommand(cmd);
+
+    auto which = _binProviderMap.find(cmd);
+    if (which != _binProviderMap.end()) {
+        // call more than once 'offerRequest' with the same 'cmd'
+        // do nothing
+        //
+        return;
+    }
+
+    _binProviderMap[cmd] = func;
+    _providerImpl->onBinCmd(cmd, func);
+    routeLocally(cmd);
+}
+
+// this host's own offers never come back (the consumer filters
+// them out), a command both wanted and provided here is routed to
+// this host's provider directly
+//
+void cc::CorbaCommImpl::routeLocally(const char* cmd)
+{
+    CORBA::Long id = _providerImpl->provides(cmd);
+    if (id < 0 || routing()->wantCommands.count(cmd) == 0)
+        return;
+
+    updateRouting([&](RoutingTable& table) {
+        table.routes[table.wantCommands.find(cmd)->second].localCmdId = id;
+    });
+    unblockedCmd(cmd);
+}
+
+void cc::CorbaCommImpl::offerCommand(const char* cmd)
+{
+    if (_hostId != cmd && routing()->offerCommands.count(cmd) == 0) {
+        updateRouting([&](RoutingTable& table) {
+            table.offerCommands.insert(cmd);
+        });
+        publishOfferCommands({cmd});
+    }
 }
 
 cc::SID cc::CorbaCommImpl::genSID() const
@@ -434,20 +2101,48 @@ cc::SID cc::CorbaCommImpl::genSID() const
 
 void cc::CorbaCommImpl::unblockedCmd(const std::string& cmd)
 {
+    std::unique_lock<std::mutex> syncLock(_syncMutex);
     auto itr = _syncMap.find(cmd);
     if (itr != _syncMap.end())
     {
+        syncLock.unlock();
         std::lock_guard<std::mutex> lock(*itr->second._mutex);
-        itr->second._cmdReady = true;
         itr->second._cv->notify_all();
     }
 }
 
-void cc::CorbaCommImpl::clearObjReference(const std::string& provider)
+cc::CorbaCommImpl::SyncObj& cc::CorbaCommImpl::syncObject(const char* cmd)
 {
-    auto itr = _objRefMap.find(provider);
-    if (itr != _objRefMap.end())
-        _objRefMap.erase(itr);
+    // entries are never erased, references to them stay valid
+    //
+    std::lock_guard<std::mutex> lock(_syncMutex);
+    auto itr = _syncMap.find(cmd);
+    if (itr == _syncMap.end())
+        itr = _syncMap.emplace(cmd, SyncObj()).first;
+    return itr->second;
+}
+
+// a provider which can't be reached is forgotten, the commands it
+// provided go to the other providers; a command without any provider
+// is routed afresh on its next call
+//
+void cc::CorbaCommImpl::dropProvider(const std::string& provider)
+{
+    updateRouting([&](RoutingTable& table) {
+        table.objRefMap.erase(provider);
+        auto load = table.loads.find(provider);
+        if (load != table.loads.end() && settledLoad(*load->second))
+            table.loads.erase(load);
+        for (auto& route : table.routes) {
+            auto& replicas = route.replicas;
+            replicas.erase(
+                std::remove_if(replicas.begin(), replicas.end(),
+                               [&](const Replica& replica) {
+                                   return replica.provider == provider;
+                               }),
+                replicas.end());
+        }
+    });
 }
 
 void cc::CorbaCommImpl::newProviderCorbaObject()
@@ -470,7 +2165,7 @@ bool cc::CorbaCommImpl::initPushConsumer()
 {
     CosNCA::EventChannel_ptr        channel;
 
-    channel = getOrCreateChannel();
+    channel = getOrCreateChannel(_channelName);
     if (CORBA::is_nil(channel)) {
         std::cerr << "Can't create event channel.\n";
         return false;
@@ -480,17 +2175,26 @@ bool cc::CorbaCommImpl::initPushConsumer()
         CosN::EventTypeSeq  evs;
         evs.length(0);
 
-        char  constraint[80];       // filter constraint
-        std::sprintf(constraint, "$sender != '%s'", _hostId.c_str());
+        // filter constraints, nothing until topics are added
+        // by 'onEvent()' (a filter without constraints isn't created)
+        //
+        const std::string constraint = "FALSE";
+
+        // batched delivery, a sequence consumer gets
+        // a batch of events per call from the channel
+        //
+        if (_options.consumeBatchSize > 1)
+            return initSequencePushConsumer(channel, evs, constraint.c_str());
 
         _pushConsumer = 
         PushConsumer_i::create(_orb, channel, "Push Consumer", consumeCallback,
-                               nullptr, &evs, constraint);
+                               nullptr, &evs, constraint.c_str());
 
         if (!_pushConsumer) {
             std::cerr << "Can't construct push consumer.\n";
             return false;
         }
+        _topicFilter = _pushConsumer->filter();
 
         CosNC::StructuredPushConsumer_var 
         pushConsumerRef = _pushConsumer->_this();
@@ -523,7 +2227,7 @@ bool cc::CorbaCommImpl::initPushSupplier()
 {
     CosNCA::EventChannel_ptr        channel;
 
-    channel = getOrCreateChannel();
+    channel = getOrCreateChannel(_channelName);
     if (CORBA::is_nil(channel)) {
         std::cerr << "Can't create event channel.\n";
         return false;
@@ -532,6 +2236,12 @@ bool cc::CorbaCommImpl::initPushSupplier()
     try {
         CosN::EventTypeSeq  evs;
         evs.length(0);
+
+        // batched publishing, a sequence supplier carries
+        // a batch of events per call to the channel
+        //
+        if (_options.eventBatchSize > 1) 
+            return initSequencePushSupplier(channel, evs);
         
         _pushSupplier = 
         PushSupplier_i::create(_orb, channel, "Push Supplier",
@@ -569,24 +2279,244 @@ bool cc::CorbaCommImpl::initPushSupplier()
     }
 }
 
-bool cc::CorbaCommImpl::initProviderImpl(const CosNaming::Name& name)
+// must be called under '_pollMutex'
+// the filter passes nothing until 'pollTopic()' adds topics; the
+// channel holds at most 'pollQueueSize' events for a host which
+// doesn't keep up, instead of buffering without bound
+//
+bool cc::CorbaCommImpl::initPullConsumer()
 {
+    CosNCA::EventChannel_ptr channel = getOrCreateChannel(_channelName);
+    if (CORBA::is_nil(channel)) {
+        std::cerr << "Can't create event channel.\n";
+        return false;
+    }
+
     try {
-        Compression::CompressorIdLevelList ids;
-        ids.length(1);
-        ids[0].compressor_id = Compression::COMPRESSORID_ZLIB;
-        ids[0].compression_level = 6;
+        CosN::EventTypeSeq  evs;
+        evs.length(0);
+
+        SequencePullConsumer_i* consumer = 
+        SequencePullConsumer_i::create(_orb, channel, "Sequence Pull Consumer",
+                                       nullptr, &evs, "FALSE");
+        if (!consumer) {
+            std::cerr << "Can't construct sequence pull consumer.\n";
+            return false;
+        }
+
+        if (_options.pollQueueSize > 0) {
+            CosN::QoSProperties qos;
+            qos.length(1);
+            qos[0].name    = CORBA::string_dup(CosN::MaxEventsPerConsumer);
+            qos[0].value <<= (CORBA::Long)_options.pollQueueSize;
+            consumer->set_qos(qos);
+        }
+
+        CosNC::SequencePullConsumer_var 
+        pullConsumerRef = consumer->_this();
+
+        consumer->_remove_ref();
+        if (consumer->connect())
+            return false;
+
+        _pollFilter   = consumer->filter();
+        _pullConsumer = consumer;
+        return true;
+    }
+    catch (CORBA::Exception& ex) {
+        std::cerr << "Can't connect sequence pull consumer: " 
+                  << ex._name() << "\n";
+        return false;
+    }
+}
+
+// routing announcements, a supplier and a consumer of their own
+// on the control channel, never batched
+//
+bool cc::CorbaCommImpl::initControlChannel()
+{
+    CosNCA::EventChannel_ptr        channel;
+
+    channel = getOrCreateChannel(_controlChannelName);
+    if (CORBA::is_nil(channel)) {
+        std::cerr << "Can't create control channel.\n";
+        return false;
+    }
+
+    try {
+        CosN::EventTypeSeq  evs;
+        evs.length(0);
+
+        _controlSupplier = 
+        PushSupplier_i::create(_orb, channel, "Control Supplier",
+                               nullptr, &evs, nullptr);
+        if (!_controlSupplier) {
+            std::cerr << "Can't construct control supplier.\n";
+            return false;
+        }
+
+        CosNC::StructuredPushSupplier_var 
+        controlSupplierRef = _controlSupplier->_this();
+
+        _controlSupplier->_remove_ref();
+        _controlSupplier->connect();
+
+        const std::string constraint = "$sender != " + tclString(_hostId);
+        _controlConsumer = 
+        PushConsumer_i::create(_orb, channel, "Control Consumer", 
+                               consumeControlCallback, nullptr, 
+                               &evs, constraint.c_str());
+        if (!_controlConsumer) {
+            std::cerr << "Can't construct control consumer.\n";
+            return false;
+        }
+
+        CosNC::StructuredPushConsumer_var 
+        controlConsumerRef = _controlConsumer->_this();
+
+        _controlConsumer->_remove_ref();
+        _controlConsumer->connect();
+        return true;
+    }
+    catch (CORBA::Exception& ex) {
+        std::cerr << "Can't connect to control channel: " 
+                  << ex._name() << "\n";
+        return false;
+    }
+}
+
+// must be called in 'initPushConsumer()'
+//
+bool cc::CorbaCommImpl::initSequencePushConsumer(
+                           CosNCA::EventChannel_ptr channel,
+                           CosN::EventTypeSeq&      evs,
+                           const char*              constraint)
+{
+    _seqPushConsumer = 
+    SequencePushConsumer_i::create(_orb, channel, "Sequence Push Consumer",
+                                   consumeBatchCallback, nullptr, 
+                                   &evs, constraint);
+
+    if (!_seqPushConsumer) {
+        std::cerr << "Can't construct sequence push consumer.\n";
+        return false;
+    }
+    _topicFilter = _seqPushConsumer->filter();
+
+    // a batch is delivered when it's full or the pacing interval
+    // (in TimeBase::TimeT, 100ns units) is up, whichever comes first
+    //
+    CosN::QoSProperties qos;
+    qos.length(2);
+    qos[0].name    = CORBA::string_dup(CosN::MaximumBatchSize);
+    qos[0].value <<= (CORBA::Long)_options.consumeBatchSize;
+    qos[1].name    = CORBA::string_dup(CosN::PacingInterval);
+    qos[1].value <<= (TimeBase::TimeT)_options.consumePacingMs * 10000;
+    _seqPushConsumer->set_qos(qos);
+
+    CosNC::SequencePushConsumer_var 
+    pushConsumerRef = _seqPushConsumer->_this();
+
+    _seqPushConsumer->_remove_ref();
+    _seqPushConsumer->connect();
+
+    if (!_orbRunning) {
+        PortableServer::POAManager_var pman = _poa->the_POAManager();
+        pman->activate();
+
+        // since ORB::run() will block execution
+        // make ORB::run() in detached thread
+        // or this methond won't return
+        //
+        std::thread([&]() { _orb->run(); }).detach();
+        _orbRunning = true;
+    }
+    return true;
+}
+
+// must be called in 'initPushSupplier()'
+//
+bool cc::CorbaCommImpl::initSequencePushSupplier(
+                           CosNCA::EventChannel_ptr channel,
+                           CosN::EventTypeSeq&      evs)
+{
+    _seqPushSupplier = 
+    SequencePushSupplier_i::create(_orb, channel, "Sequence Push Supplier",
+                                   nullptr, &evs, nullptr);
+
+    if (!_seqPushSupplier) {
+        std::cerr << "Can't construct sequence push supplier.\n";
+        return false;
+    }
+
+    CosNC::SequencePushSupplier_var 
+    pushSupplierRef = _seqPushSupplier->_this();
+
+    _seqPushSupplier->_remove_ref();
+    _seqPushSupplier->connect();
+
+    _batcher = std::make_unique<cc::EventBatcher>(
+        _options.eventBatchSize, _options.eventBatchDelayMs,
+        [this](const CosN::EventBatch& batch) {
+            try {
+                _seqPushSupplier->push(batch);
+                return true;
+            }
+            catch (...) {
+                std::cerr << "send failure\n";
+                return false;
+            }
+        });
+
+    if (!_orbRunning) {
+        PortableServer::POAManager_var pman = _poa->the_POAManager();
+        pman->activate();
+
+        // since ORB::run() will block execution
+        // make ORB::run() in detached thread
+        // or this methond won't return
+        //
+        std::thread([&]() { _orb->run(); }).detach();
+        _orbRunning = true;
+    }
+    return true;
+}
+
+// static
+CORBA::PolicyList 
+cc::CorbaCommImpl::compressionPolicies(const cc::CompressionPolicy& policy)
+{
+    CORBA::PolicyList pl;
+    if (!policy.enabled) {
+        pl.length(1);
+        pl[0] = omniZIOP::create_compression_enabling_policy(0);
+        return pl;
+    }
 
-        CORBA::PolicyList pl;
-        pl.length(2);
-        pl[0] = omniZIOP::create_compression_enabling_policy(1);
-        pl[1] = omniZIOP::create_compression_id_level_list_policy(ids);
+    Compression::CompressorIdLevelList ids;
+    ids.length(1);
+    ids[0].compressor_id = Compression::COMPRESSORID_ZLIB;
+    ids[0].compression_level = policy.level;
+
+    pl.length(3);
+    pl[0] = omniZIOP::create_compression_enabling_policy(1);
+    pl[1] = omniZIOP::create_compression_id_level_list_policy(ids);
+    pl[2] = omniZIOP::create_compression_low_value_policy(policy.minSize);
+    return pl;
+}
+
+bool cc::CorbaCommImpl::initProviderImpl(const CosNaming::Name& name)
+{
+    try {
+        // replies are compressed only if the requester's policy allows
+        //
+        CORBA::PolicyList pl = compressionPolicies(_options.compression);
 
         PortableServer::POAManager_var pman = _poa->the_POAManager();
         PortableServer::POA_var poa = 
         _poa->create_POA("Custom POA", pman, pl);
 
-        _providerImpl = new ProviderImpl();
+        _providerImpl = new ProviderImpl(_hostId.c_str(), _options);
         PortableServer::ObjectId_var 
         providerId = poa->activate_object(_providerImpl);
         CORBA::Object_var obj = _providerImpl->_this();
@@ -668,7 +2598,8 @@ bool cc::CorbaCommImpl::bindObjectToName(const CosNaming::Name& objName,
     return 1;
 }
 
-CosNCA::EventChannel_ptr cc::CorbaCommImpl::getOrCreateChannel()
+CosNCA::EventChannel_ptr 
+cc::CorbaCommImpl::getOrCreateChannel(const std::string& channelName)
 {
     CosNCA::EventChannel_ptr channel = CosNCA::EventChannel::_nil();
     CosNaming::Name          name;
@@ -676,8 +2607,8 @@ CosNCA::EventChannel_ptr cc::CorbaCommImpl::getOrCreateChannel()
     // resolve from Name Server
     //
     name.length(1);
-    name[0].id   = _channelName.c_str();
-    name[0].kind = _channelName.c_str();
+    name[0].id   = channelName.c_str();
+    name[0].kind = channelName.c_str();
 
     try {
         CORBA::Object_var   obj = _nameCtx->resolve(name);
@@ -722,12 +2653,42 @@ CosNCA::EventChannel_ptr cc::CorbaCommImpl::getOrCreateChannel()
         qosProp.length(0);
         adminProp.length(0);
 
+        // routing announcements keep the control channel's defaults
+        //
+        if (channelName == _channelName)
+            channelProperties(_options.channelQoS, qosProp, adminProp);
+
         channel = factory->create_channel(qosProp, adminProp, channelId);
     }
     catch (...) {
         // TODO: more concrete info
         //
     }
+    if (CORBA::is_nil(channel))
+        return channel;
+
+    // bind it, so other hosts find the same channel;
+    // if another host was faster, use its channel instead
+    //
+    name.length(1);
+    name[0].id   = channelName.c_str();
+    name[0].kind = channelName.c_str();
+    try {
+        _nameCtx->bind(name, channel);
+    }
+    catch (CosNaming::NamingContext::AlreadyBound&) {
+        try {
+            CORBA::Object_var   obj = _nameCtx->resolve(name);
+            CosNCA::EventChannel_ptr bound = CosNCA::EventChannel::_narrow(obj);
+            channel->destroy();
+            CORBA::release(channel);
+            channel = bound;
+        }
+        catch (...) {
+        }
+    }
+    catch (...) {
+    }
 
     return channel;
 }
@@ -756,12 +2717,24 @@ CORBA::Object_ptr cc::CorbaCommImpl::resolveObjectReference(
 void cc::CorbaCommImpl::publishCommandsType(const cc::Commands& services,
                                             std::string type) const
 {
+    const bool offer = type == "offer services";
     for (const auto& cmd : services) {
         cc::CorbaCommImpl::Filters filters = {{
             std::make_pair(std::string("sender"), _hostId),
             std::make_pair(type, cmd)
         }};
-        pushEvent("-1", "", filters);
+
+        // a provider announces its id of the command and its epoch in
+        // the body, requesters invoke the command by this id later
+        //
+        std::string body;
+        if (offer)
+            body = std::to_string(_providerImpl->intern(cmd.c_str())) + 
+                   ":" + std::to_string(_providerImpl->epoch());
+
+        CosN::StructuredEvent ev;
+        ev.remainder_of_body <<= body.c_str();
+        pushStructuredEvent(ev, filters, true);
     }
 }
 
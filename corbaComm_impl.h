@@ -1,10 +1,16 @@
 #ifndef _CORBA_COMM_IMPL_H
 #define _CORBA_COMM_IMPL_H
 #include <map>
+#include <set>
 #include <utility>
 #include <vector>
 #include <array>
 #include <mutex>
+#include <memory>
+#include <atomic>
+#include <future>
+#include <functional>
+#include <chrono>
 #include <condition_variable>
 #include <string.h>
 #include "corbaComm.hh"
@@ -12,20 +18,33 @@
 #include "cos.h"
 #include "notify_impl.h"
 #include "provider.h"
+#include "dispatcher.h"
+#include "providerref.h"
+#include "asyncreply.h"
+#include "resultcache.h"
+#include "batcher.h"
+#include "executor.h"
+#include "publishq.h"
 
 namespace cc {
 
 class CorbaCommImpl {
 public:
-    typedef std::pair<std::string, std::string> Cmd2ProviderInfo;
+    struct Cmd2ProviderInfo {
+        std::string cmd;
+        std::string provider;
+        CORBA::Long cmdId;          // provider's id of 'cmd', -1: unknown
+        uint64_t    epoch;          // provider's incarnation, 0: unknown
+    };
     struct SupplierFailureException { };
     struct ConsumerFailureException { };
     struct CorbaObjectImplFailure   { };
     ~CorbaCommImpl();
     void tryDispatchEvent(const CosN::StructuredEvent&) const;
+    void tryDispatchEvents(const CosN::EventBatch&);
     void trySetProviderInfo(const CosN::StructuredEvent&);
     void trySetProviderInfo(const Cmd2ProviderInfo&);
-    void tryPublishOfferService(const CosN::StructuredEvent&) const;
+    void tryPublishOfferService(const CosN::StructuredEvent&);
 
     // Big-5 rules
     CorbaCommImpl() = delete;
@@ -43,27 +62,81 @@ private:
     CorbaCommImpl(const char* hostId,
                   Commands    offerCommands,
                   Commands    wantCommands,
-                  int argc, char* argv[]);
+                  int argc, char* argv[],
+                  const Options& options);
     SID  onEvent(const char* topic, EventCallback_t callback);
+    SID  onBinEvent(const char* topic, BinaryEventCallback_t callback);
+    SID  onEventBatch(const char* topic, EventBatchCallback_t callback);
     void detachEvent(const SID&);
     bool pushEvent(const char* topic, const char* param) const;
+    bool pushBinEvent(const char* topic, const void* data, size_t length) const;
     bool pushEvent(const char* topic, const char* param, 
                    const Filters& filters) const;
+    bool pushStructuredEvent(CosN::StructuredEvent&, 
+                             const Filters& filters,
+                             bool control = false) const;
+    bool sendEvent(const CosN::StructuredEvent&) const;
+    bool flushEvents() const;
+    PublishStats publishStats() const;
+    bool setChannelQoS(const ChannelQoS& qos);
+    void setTopicQoS(const char* topic, const TopicQoS& qos);
+    void topicHeader(CosN::StructuredEvent&, const std::string& topic) const;
+    static bool channelProperties(const ChannelQoS&, 
+                                  CosN::QoSProperties&,
+                                  CosN::AdminProperties&);
+    Filters eventFilters(const char* topic) const;
+    static std::string tclString(const std::string&);
+    static bool eventBody(const CosN::StructuredEvent&, const char*& topic,
+                          const char*& data, size_t& length);
+    void dispatchEvents(const char* topic, const EventViews&) const;
+    void deliverEvents(const char* topic, const EventViews&) const;
+    DispatchStats dispatchStats() const;
+    bool pollTopic(const char* topic);
+    void unpollTopic(const char* topic);
+    PolledEvents pollEvents(size_t maxBatch, unsigned timeoutMs);
     std::string execCmd(const char* cmd, const char* param);
+    std::string execCmdById(CmdId id, const char* param);
+    CmdId       internCmd(const char* cmd);
+    std::string invokeCmd(CmdId id, const char* param);
+    bool        postCmd(const char* cmd, const char* param);
+    bool        flushCmds(unsigned timeoutMs);
+    void        cacheCmd(const char* cmd, unsigned ttlMs);
+    CacheStats  cacheStats() const;
+    void        setCallPolicy(const char* cmd, const CallPolicy& policy);
+    HedgeStats  hedgeStats() const;
+    std::string execBinCmd(const char* cmd, const void* data, size_t length);
+    CmdStatus   execBinCmd(const char* cmd, const void* data, size_t length,
+                           std::string& result);
+    Results     execBatch(const CmdRequests& requests);
+    std::future<CmdResult> execCmdAsync(const char* cmd, const char* param);
+    void execCmdAsync(const char* cmd, const char* param,
+                      CompletionCallback_t callback);
     void onCmd(const char* cmd, CommandCallback_t cmdCallback);
+    void onBinCmd(const char* cmd, BinaryCommandCallback_t cmdCallback);
+    void offerCommand(const char* cmd);
+    void routeLocally(const char* cmd);
 
     SID  genSID() const;
     void unblockedCmd(const std::string&);
-    void clearObjReference(const std::string&);
+    void dropProvider(const std::string&);
+    ProviderRef::Handle getObjReference(const std::string&, 
+                                          size_t compression = 0);
 
     // CORBA
     //
     void newProviderCorbaObject();
     bool initPushConsumer();
     bool initPushSupplier();
+    bool initSequencePushConsumer(CosNCA::EventChannel_ptr, 
+                                  CosN::EventTypeSeq&, const char*);
+    bool initSequencePushSupplier(CosNCA::EventChannel_ptr, 
+                                  CosN::EventTypeSeq&);
     bool initProviderImpl(const CosNaming::Name&);
+    static CORBA::PolicyList compressionPolicies(const CompressionPolicy&);
     bool bindObjectToName(const CosNaming::Name&, CORBA::Object_ptr);
-    CosNCA::EventChannel_ptr getOrCreateChannel();
+    bool initControlChannel();
+    bool initPullConsumer();
+    CosNCA::EventChannel_ptr getOrCreateChannel(const std::string&);
     CORBA::Object_ptr resolveObjectReference(const CosNaming::Name&) const;
     
     // CorbaCommImpl
@@ -73,29 +146,229 @@ private:
     void publishWantCommands(const Commands&) const;
 
     typedef std::vector<EventCallback_t>             AllCallbacks;
-    typedef std::map<std::string, AllCallbacks>      SubscribeMap;
+    typedef std::map<std::string, AllCallbacks, std::less<>> SubscribeMap;
     typedef std::pair<std::string, EventCallback_t>  EvtInfo;
     typedef std::map<std::string, EvtInfo>           EvtInfoMap;
     typedef std::map<std::string, CommandCallback_t> ProviderMap;
+    typedef std::vector<BinaryEventCallback_t>            BinAllCallbacks;
+    typedef std::map<std::string, BinAllCallbacks, std::less<>> 
+                                                          BinSubscribeMap;
+    typedef std::pair<std::string, BinaryEventCallback_t> BinEvtInfo;
+    typedef std::map<std::string, BinEvtInfo>             BinEvtInfoMap;
+    typedef std::map<std::string, BinaryCommandCallback_t> BinProviderMap;
+    typedef std::vector<EventBatchCallback_t>             BatchAllCallbacks;
+    typedef std::map<std::string, BatchAllCallbacks, std::less<>> 
+                                                          BatchSubscribeMap;
+    typedef std::pair<std::string, EventBatchCallback_t>  BatchEvtInfo;
+    typedef std::map<std::string, BatchEvtInfo>           BatchEvtInfoMap;
+
+    // subscriptions, the same copy-on-write scheme as 'RoutingTable'
+    // event dispatch (ORB or executor threads) only loads the current
+    // snapshot, without copying; 'onEvent()' and friends modify a copy
+    // and publish it
+    //
+    struct Subscriptions {
+        SubscribeMap      subscribeMap;
+        EvtInfoMap        evtInfoMap;
+        BinSubscribeMap   binSubscribeMap;
+        BinEvtInfoMap     binEvtInfoMap;
+        BatchSubscribeMap batchSubscribeMap;
+        BatchEvtInfoMap   batchEvtInfoMap;
+    };
+    typedef std::shared_ptr<const Subscriptions> SubscriptionSnapshot;
+
+    SubscriptionSnapshot subscriptions() const;
+    bool publishSubscriptions(std::shared_ptr<Subscriptions>, 
+                              const std::string& topic);
+    bool syncTopicFilter(const Subscriptions&, const std::string& topic);
+    bool addTopicConstraint(CosNF::Filter_ptr, const std::string& topic,
+                            CosNF::ConstraintID&) const;
+    static void removeConstraint(CosNF::Filter_ptr, CosNF::ConstraintID,
+                                 const std::string& topic);
+    void dispatchEvent(const Subscriptions&, const char* topic, 
+                       const char* data, size_t length) const;
+    void dispatchBatch(const Subscriptions&, const char* topic, 
+                       const EventViews&) const;
+
+    template <typename Callback>
+    SID  subscribe(std::map<std::string, std::vector<Callback>, std::less<>>
+                                             Subscriptions::*subscribeMap,
+                   std::map<SID, std::pair<std::string, Callback>> 
+                                             Subscriptions::*infoMap,
+                   const char* topic, Callback callback);
+    template <typename Callback>
+    bool unsubscribe(std::map<std::string, std::vector<Callback>, 
+                              std::less<>>&,
+                     std::map<SID, std::pair<std::string, Callback>>&,
+                     const SID&, std::string& topic);
 
     // for host which wants to understand who is request provider
+    // (std::less<> to look up by 'const char*' without a temporary string)
+    //
+    typedef std::set<std::string, std::less<>>  CommandSet;
+    typedef std::map<std::string, CmdId, std::less<>>  CmdIdMap;
+    // per provider, one reference per compression policy
+    //
+    typedef std::vector<std::shared_ptr<ProviderRef>>  ProviderRefs;
+    typedef std::map<std::string, ProviderRefs>        ObjRefMap;
+
+    // a provider's load as this host sees it, shared by all the
+    // commands it provides, 'outstanding' and 'latencyUs' are atomics;
+    // and the commands posted to its incarnation 'epoch' (0: unknown),
+    // 'settled' of them confirmed by a flush; a dropped provider's load
+    // is kept until its posted commands are settled
+    //
+    struct Load {
+        std::atomic<unsigned> outstanding{0};
+        std::atomic<uint64_t> latencyUs{0};     // moving average
+        std::mutex            postMutex;
+        uint64_t              epoch   = 0;
+        uint64_t              posted  = 0;
+        uint64_t              settled = 0;
+    };
+    typedef std::map<std::string, std::shared_ptr<Load>> LoadMap;
+
+    // a provider of a command, 'cmdId' is the provider's id of the
+    // command, -1 if the provider doesn't tell (it's invoked by name)
+    //
+    struct Replica {
+        std::string           provider;
+        CORBA::Long           cmdId;
+        std::shared_ptr<Load> load;
+    };
+
+    // a command's recent latencies, for its hedging threshold
+    // the 95th percentile is re-computed every 16 samples
+    // and its recent hedged calls, for its hedging budget: 'hedge()'
+    // returns true if a call may be hedged, at most 'budget' percent
+    // of the calls of a window of 128 are
     //
-    typedef std::map<std::string, std::string>  ProviderInfoMap;
-    typedef std::map<std::string, CorbaCommModule::Provider_ptr> ObjRefMap;
+    class Latency {
+    public:
+        void     record(uint64_t us);
+        uint64_t p95() const { return _p95.load(std::memory_order_relaxed); }
+        void     called();
+        bool     hedge(unsigned budget);
+    private:
+        std::array<uint64_t, 128> _samples{};
+        size_t                    _count = 0;
+        unsigned                  _calls  = 0;  // of the current window
+        unsigned                  _hedges = 0;
+        std::mutex                _mutex;
+        std::atomic<uint64_t>     _p95{0};      // 0: not known yet
+    };
+
+    // how a wanted command is routed, 'replicas' is empty until
+    // a provider answers; 'localCmdId' is not -1 if this host provides
+    // the command, it's then called directly, not through the ORB
+    //
+    struct Route {
+        std::string                            cmd;
+        std::vector<Replica>                   replicas;
+        CORBA::Long                            localCmdId;
+        std::shared_ptr<std::atomic<unsigned>> next;    // for round-robin
+        size_t      compression;        // index of '_compression'
+        unsigned    cacheTtlMs;         // 0: not cached
+        CallPolicy                             policy;
+        std::shared_ptr<Latency>               latency;
+    };
+    typedef std::vector<Route>  Routes;
+
+    // command routing tables
+    // a published table is never modified, writers (mostly the ORB thread)
+    // copy it, modify the copy and publish the copy atomically;
+    // readers (execCmd and friends) only load the current snapshot
+    //
+    // the snapshot isn't lock-free: libstdc++'s atomic_load()/atomic_store()
+    // of a shared_ptr take a mutex from a small global pool (hashed by the
+    // pointer's address), held just for the reference count; readers never
+    // wait for a writer's copy, nor for '_routingMutex', but they do
+    // contend on that pool mutex with each other
+    //
+    struct RoutingTable {
+        CommandSet      offerCommands;
+        CmdIdMap        wantCommands;       // interned, index of 'routes'
+        Routes          routes;
+        ObjRefMap       objRefMap;
+        LoadMap         loads;
+    };
+    typedef std::shared_ptr<const RoutingTable> RoutingSnapshot;
+
+    CmdId internCmd(RoutingTable&, const char* cmd) const;
+    size_t compressionOf(const std::string& cmd) const;
+    const Route* lookupRoute(CmdId id, RoutingSnapshot& table);
+    const Replica& balance(const Route&) const;
+    bool callProvider(const Route&, const Replica&, 
+                      const char* param, std::string& result);
+    std::string invokeHedged(const RoutingSnapshot&, const Route&,
+                             const char* param);
+    void sendAsync(const char* cmd, const char* param,
+                   std::function<void(const CmdResult&)> complete);
+    void asyncDone();
+    static void addReplica(RoutingTable&, const char* cmd, 
+                           const char* provider, CORBA::Long cmdId,
+                           uint64_t epoch);
+    static bool routed(const RoutingTable&, const std::string& provider);
+    static bool settledLoad(Load&);
+
+    // a call to a provider, it's counted in flight while it lives,
+    // and its latency is measured when it's done
+    //
+    class Call {
+    public:
+        explicit Call(const Replica&);
+        ~Call();
+        uint64_t done();        // returns the latency in microseconds
+    private:
+        Load*                                 _load;
+        std::chrono::steady_clock::time_point _start;
+    };
+
+    RoutingSnapshot routing() const;
+    template <typename Modifier>
+    void updateRouting(Modifier modify);
 
     std::string     _hostId;
-    Commands        _offerCommands;
-    Commands        _wantCommands;
-    SubscribeMap    _subscribeMap;
-    EvtInfoMap      _evtInfoMap;
+    RoutingSnapshot _routing;
+    std::mutex      _routingMutex;      // serializes writers only
     ProviderMap     _providerMap;
-    ProviderInfoMap _providerInfoMap;
-    ObjRefMap       _objRefMap;
+    BinProviderMap  _binProviderMap;
+    SubscriptionSnapshot _subscriptions;
+    std::mutex           _subscriptionMutex;    // serializes writers only
+
+    // per-topic QoS of published events, copied on write
+    //
+    typedef std::shared_ptr<const std::map<std::string, TopicQoS>>
+            TopicQoSSnapshot;
+    TopicQoSSnapshot     _topicQoS;
+    std::mutex           _topicQoSMutex;        // serializes writers only
 
     // CORBA
     //
     PushSupplier_i*                           _pushSupplier;
+    SequencePushSupplier_i*                   _seqPushSupplier;
     PushConsumer_i*                           _pushConsumer;
+    SequencePushConsumer_i*                   _seqPushConsumer;
+
+    // routing announcements, on the control channel
+    //
+    PushSupplier_i*                           _controlSupplier;
+    PushConsumer_i*                           _controlConsumer;
+
+    // the consumer's filter (owned by the consumer), a constraint
+    // per subscribed topic, 'onEvent()' and 'detachEvent()' keep it
+    // (under '_subscriptionMutex')
+    //
+    CosNF::Filter_ptr                         _topicFilter;
+    std::map<std::string, CosNF::ConstraintID> _topicConstraints;
+
+    // pull mode, connected by the first 'pollTopic()', its filter has
+    // a constraint per polled topic (under '_pollMutex')
+    //
+    SequencePullConsumer_i*                   _pullConsumer;
+    CosNF::Filter_ptr                         _pollFilter;
+    std::map<std::string, CosNF::ConstraintID> _pollConstraints;
+    std::mutex                                _pollMutex;
     CORBA::ORB_var                            _orb;
     PortableServer::POA_var                   _poa;
     CosNaming::NamingContext_var              _nameCtx;
@@ -103,20 +376,67 @@ private:
     bool                                      _orbRunning;
 
     // for 'lazy command routing' sync
+    // one SyncObj per command, shared by all callers waiting for it;
+    // a 'want services' query is published only when '_retryAt' is due,
+    // so concurrent callers share one in-flight query, and 
+    // unanswered queries are retried with exponential backoff
     //
     struct SyncObj {
         std::unique_ptr<std::mutex>              _mutex;
         std::unique_ptr<std::condition_variable> _cv;
-        bool                                     _cmdReady;
+        std::chrono::steady_clock::time_point    _retryAt;
+        std::chrono::milliseconds                _backoff;
+        unsigned                                 _waiters;
         SyncObj() {
             _mutex    = std::make_unique<std::mutex>();
             _cv       = std::make_unique<std::condition_variable>();
-            _cmdReady = false;
+            _retryAt  = std::chrono::steady_clock::time_point::min();
+            _backoff  = std::chrono::milliseconds::zero();
+            _waiters  = 0;
         }
     };
-    std::map<std::string, SyncObj>  _syncMap;
+    SyncObj& syncObject(const char* cmd);
+    std::map<std::string, SyncObj, std::less<>>  _syncMap;
+    std::mutex                                   _syncMutex;
+
+    Options                     _options;
+
+    // 'execCmdAsync()' requests in flight, the dtor waits for them
+    //
+    std::atomic<unsigned>       _asyncInFlight{0};
+    std::mutex                  _asyncMutex;
+    std::condition_variable     _asyncCv;
+
+    // compression policies, [0] is for every command,
+    // the rest are per-command overrides, in 'cmdCompression' order
+    //
+    std::vector<CompressionPolicy> _compression;
+
+    // results of cacheable commands
+    //
+    std::unique_ptr<ResultCache>   _cache;
+
+    // sends hedged requests, it's started on demand
+    //
+    std::unique_ptr<Dispatcher>    _hedger;
+    std::once_flag                 _hedgerOnce;
+    std::atomic<uint64_t>          _hedgesSent{0};
+    std::atomic<uint64_t>          _hedgesWon{0};
+
+    // delivers events to subscribers, with 'eventThreads' only
+    //
+    std::unique_ptr<Executor>      _executor;
+
+    // batches published events, with 'eventBatchSize' > 1 only
+    //
+    std::unique_ptr<EventBatcher>  _batcher;
+
+    // queues published events, with 'asyncPublish' only
+    //
+    std::unique_ptr<PublishQueue>  _publishQueue;
 
     const std::string _channelName = "EventChannel";
+    const std::string _controlChannelName = "ControlChannel";
     const std::string _factoryName = "ChannelFactory";
 };
 
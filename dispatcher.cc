@@ -0,0 +1,79 @@
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "dispatcher.h"
+
+cc::Dispatcher::Dispatcher(unsigned threads, size_t maxPending)
+              : _maxPending{maxPending}
+              , _stopping{false}
+{
+    if (0 == threads)
+        threads = 1;
+    for (unsigned i = 0; i < threads; ++i)
+        _workers.emplace_back([this]() { run(); });
+}
+
+cc::Dispatcher::~Dispatcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _cv.notify_all();
+    for (auto& worker : _workers)
+        worker.join();
+}
+
+void cc::Dispatcher::post(cc::Dispatcher::Task task)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _tasks.push_back(std::move(task));
+    }
+    _cv.notify_one();
+}
+
+bool cc::Dispatcher::tryPost(cc::Dispatcher::Task task)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_maxPending > 0 && _tasks.size() >= _maxPending)
+            return false;
+        _tasks.push_back(std::move(task));
+    }
+    _cv.notify_one();
+    return true;
+}
+
+size_t cc::Dispatcher::pending() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _tasks.size();
+}
+
+void cc::Dispatcher::run()
+{
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv.wait(lock, [this]() { return _stopping || !_tasks.empty(); });
+
+            // drain what is left before leaving
+            //
+            if (_tasks.empty())
+                return;
+            task = std::move(_tasks.front());
+            _tasks.pop_front();
+        }
+        try {
+            task();
+        }
+        catch (...) {
+            // a task must never take a worker down
+            //
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef _DISPATCHER_H
+#define _DISPATCHER_H
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+namespace cc {
+
+// a small fixed-size thread pool
+// tasks are run in FIFO order by whichever worker is free first;
+// with 'maxPending', 'tryPost()' refuses a task beyond it
+//
+class Dispatcher {
+public:
+    typedef std::function<void()> Task;
+
+    explicit Dispatcher(unsigned threads, size_t maxPending = 0);
+    ~Dispatcher();
+
+    void   post(Task task);
+    bool   tryPost(Task task);  // false if 'maxPending' tasks are queued
+    size_t pending() const;
+
+    // Big-5 rules
+    Dispatcher() = delete;
+    Dispatcher(const Dispatcher&) = delete;
+    Dispatcher(Dispatcher&&) = delete;
+    Dispatcher& operator=(const Dispatcher&) = delete;
+    Dispatcher& operator=(Dispatcher&&) = delete;
+
+private:
+    void run();
+
+    std::vector<std::thread>  _workers;
+    std::deque<Task>          _tasks;
+    mutable std::mutex        _mutex;
+    std::condition_variable   _cv;
+    const size_t              _maxPending;  // 0: unbounded
+    bool                      _stopping;
+};
+
+};  // namespace cc
+
+#endif
@@ -0,0 +1,207 @@
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <thread>
+#include "executor.h"
+
+// jobs of a strand a worker runs before the other strands' turn
+//
+static const size_t strandBatch = 64;
+
+cc::Executor::Strand::Strand()
+                    : _head{&_stub}
+                    , _tail{&_stub}
+{
+}
+
+cc::Executor::Strand::~Strand()
+{
+    while (Node* node = pop())
+        delete node;
+}
+
+void cc::Executor::Strand::push(Node* node)
+{
+    node->next.store(nullptr, std::memory_order_relaxed);
+    Node* prev = _head.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+}
+
+// nullptr if it's empty, or a push is half done
+//
+cc::Executor::Node* cc::Executor::Strand::pop()
+{
+    Node* tail = _tail;
+    Node* next = tail->next.load(std::memory_order_acquire);
+    if (tail == &_stub) {
+        if (nullptr == next)
+            return nullptr;
+        _tail = next;
+        tail  = next;
+        next  = next->next.load(std::memory_order_acquire);
+    }
+    if (next) {
+        _tail = next;
+        return tail;
+    }
+    if (tail != _head.load(std::memory_order_acquire))
+        return nullptr;
+
+    // 'tail' is the last one, put the stub behind it to take it
+    //
+    push(&_stub);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next) {
+        _tail = next;
+        return tail;
+    }
+    return nullptr;
+}
+
+cc::Executor::Executor(unsigned threads)
+            : _lookup{std::make_shared<std::map<std::string, Strand*,
+                                                std::less<>>>()}
+            , _stopping{false}
+{
+    if (0 == threads)
+        threads = 1;
+    for (unsigned i = 0; i < threads; ++i)
+        _workers.emplace_back([this]() { run(); });
+}
+
+cc::Executor::~Executor()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _cv.notify_all();
+    for (auto& worker : _workers)
+        worker.join();
+}
+
+void cc::Executor::post(const std::string& key, cc::Executor::Job job)
+{
+    Strand* s = strand(key);
+    Node* node     = new Node;
+    node->job      = std::move(job);
+    node->queuedAt = std::chrono::steady_clock::now();
+
+    _queued.fetch_add(1, std::memory_order_relaxed);
+    s->push(node);
+    if (0 == s->pending.fetch_add(1, std::memory_order_acq_rel))
+        schedule(s);
+}
+
+cc::Executor::Stats cc::Executor::stats() const
+{
+    return { _queued.load(std::memory_order_relaxed),
+             _done.load(std::memory_order_relaxed),
+             _latencyUs.load(std::memory_order_relaxed),
+             _maxLatencyUs.load(std::memory_order_relaxed) };
+}
+
+cc::Executor::Strand* cc::Executor::strand(const std::string& key)
+{
+    auto lookup = std::atomic_load(&_lookup);
+    auto which  = lookup->find(key);
+    if (which != lookup->end())
+        return which->second;
+
+    // a new key, copy the lookup map and publish the copy
+    //
+    std::lock_guard<std::mutex> lock(_strandsMutex);
+    auto& s = _strands[key];
+    if (!s) {
+        s = std::make_unique<Strand>();
+        auto copy = std::make_shared<std::map<std::string, Strand*,
+                                              std::less<>>>(*_lookup);
+        (*copy)[key] = s.get();
+        std::atomic_store(&_lookup,
+        std::shared_ptr<const std::map<std::string, Strand*,
+                                       std::less<>>>(std::move(copy)));
+    }
+    return s.get();
+}
+
+void cc::Executor::schedule(Strand* s)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _ready.push_back(s);
+    }
+    _cv.notify_one();
+}
+
+// runs up to 'strandBatch' jobs of the strand, it's re-scheduled
+// at the end of the ready list if jobs are left
+//
+void cc::Executor::drain(Strand& s)
+{
+    size_t done    = 0;
+    size_t pending = s.pending.load(std::memory_order_acquire);
+    while (done < pending && done < strandBatch) {
+        // a counted job is in the queue, or is being linked in
+        //
+        Node* node;
+        while (nullptr == (node = s.pop()))
+            std::this_thread::yield();
+
+        using namespace std::chrono;
+        record(duration_cast<microseconds>(steady_clock::now() -
+                                           node->queuedAt).count());
+        _queued.fetch_sub(1, std::memory_order_relaxed);
+        try {
+            node->job();
+        }
+        catch (...) {
+            // a job must never take a worker down
+            //
+        }
+        delete node;
+        _done.fetch_add(1, std::memory_order_relaxed);
+
+        if (++done == pending)
+            pending = s.pending.load(std::memory_order_acquire);
+    }
+
+    if (s.pending.fetch_sub(done, std::memory_order_acq_rel) != done)
+        schedule(&s);
+}
+
+// the latency's moving average, a new sample weighs 1/8
+//
+void cc::Executor::record(uint64_t us)
+{
+    uint64_t average = _latencyUs.load(std::memory_order_relaxed);
+    average = 0 == average ? us : average - average / 8 + us / 8;
+    _latencyUs.store(average, std::memory_order_relaxed);
+
+    uint64_t max = _maxLatencyUs.load(std::memory_order_relaxed);
+    while (us > max &&
+           !_maxLatencyUs.compare_exchange_weak(max, us,
+                                                std::memory_order_relaxed))
+        ;
+}
+
+void cc::Executor::run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _cv.wait(lock, [this]() { return _stopping || !_ready.empty(); });
+
+        // drain what is left before leaving
+        //
+        if (_ready.empty())
+            return;
+
+        Strand* s = _ready.front();
+        _ready.pop_front();
+
+        lock.unlock();
+        drain(*s);
+        lock.lock();
+    }
+}
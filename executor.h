@@ -0,0 +1,102 @@
+#ifndef _EXECUTOR_H
+#define _EXECUTOR_H
+#include <map>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+
+namespace cc {
+
+// a thread pool which runs jobs of a key (a topic) one at a time, in
+// the order they're posted, while jobs of different keys run in parallel
+//
+// each key has a strand, a lock-free multi-producer single-consumer
+// queue, so posting from ORB threads never takes a lock, unless
+// the strand was idle and has to be handed to a worker; a worker runs
+// a batch of a strand's jobs, then lets the other strands take turns
+//
+class Executor {
+public:
+    typedef std::function<void()> Job;
+    struct Stats {
+        uint64_t queued;            // jobs waiting now
+        uint64_t done;
+        uint64_t latencyUs;         // queueing, moving average
+        uint64_t maxLatencyUs;
+    };
+
+    explicit Executor(unsigned threads);
+    ~Executor();                    // runs the queued jobs, then stops
+
+    void  post(const std::string& key, Job job);
+    Stats stats() const;
+
+    // Big-5 rules
+    Executor() = delete;
+    Executor(const Executor&) = delete;
+    Executor(Executor&&) = delete;
+    Executor& operator=(const Executor&) = delete;
+    Executor& operator=(Executor&&) = delete;
+
+private:
+    struct Node {
+        Job                                   job;
+        std::chrono::steady_clock::time_point queuedAt;
+        std::atomic<Node*>                    next{nullptr};
+    };
+
+    // an intrusive MPSC queue (D. Vyukov's), 'pending' counts pushed
+    // jobs not run yet, the push which makes it 1 schedules the strand
+    //
+    class Strand {
+    public:
+        Strand();
+        ~Strand();
+        void  push(Node*);
+        Node* pop();                // the strand's worker only
+        std::atomic<size_t> pending{0};
+    private:
+        Node                _stub;
+        std::atomic<Node*>  _head;
+        Node*               _tail;
+    };
+    typedef std::map<std::string, std::unique_ptr<Strand>, std::less<>>
+            Strands;
+
+    Strand* strand(const std::string& key);
+    void    schedule(Strand*);
+    void    drain(Strand&);
+    void    record(uint64_t latencyUs);
+    void    run();
+
+    // strands are never removed, the map is copied on write
+    // (readers only load the current snapshot)
+    //
+    std::shared_ptr<const std::map<std::string, Strand*, std::less<>>>
+                             _lookup;
+    Strands                  _strands;
+    std::mutex               _strandsMutex;
+
+    std::deque<Strand*>      _ready;
+    std::mutex               _mutex;
+    std::condition_variable  _cv;
+    bool                     _stopping;
+    std::vector<std::thread> _workers;
+
+    std::atomic<uint64_t>    _queued{0};
+    std::atomic<uint64_t>    _done{0};
+    std::atomic<uint64_t>    _latencyUs{0};
+    std::atomic<uint64_t>    _maxLatencyUs{0};
+};
+
+};  // namespace cc
+
+#endif
@@ -267,6 +267,122 @@ void PushSupplier_i::subscription_change(const CosN::EventTypeSeq& added,
       ;
 }
 
+// ==================== SequencePushSupplier_i ===================
+//
+
+SequencePushSupplier_i::
+SequencePushSupplier_i(CosNCA::SequenceProxyPushConsumer_ptr proxy,
+	       CosNCA::SupplierAdmin_ptr admin, CosNF::Filter_ptr filter,
+	       const char* objnm, type_change_fn* change_fn) :
+  _my_proxy(proxy), _my_admin(admin), _my_filters(0),
+  _obj_name(objnm), _change_fn(change_fn), _verbose(0)
+{
+  if (! CORBA::is_nil(filter)) {
+    _my_filters.length(1);
+    _my_filters[0] = filter;
+  }
+}
+
+SequencePushSupplier_i*
+SequencePushSupplier_i::create(CORBA::ORB_ptr orb,
+		       CosNCA::EventChannel_ptr channel,
+		       const char* objnm,
+		       type_change_fn* change_fn,
+		       CosN::EventTypeSeq* evs_ptr,
+		       const char* constraint_expr)
+{
+  // Obtain appropriate proxy object
+  CosNCA::SupplierAdmin_ptr admin = CosNCA::SupplierAdmin::_nil();
+  CosNCA::ProxyConsumer_var generic_proxy =
+    get_proxy_consumer(orb, channel, CosNCA::SEQUENCE_EVENT, 1,  admin, 0);
+  CosNCA::SequenceProxyPushConsumer_ptr proxy = CosNCA::SequenceProxyPushConsumer::_narrow(generic_proxy);
+  if ( CORBA::is_nil(proxy) ) {
+    return 0; // get_proxy_consumer failed
+  }
+
+  // If evs or constraint_expr are non-empty, add a filter to proxy
+  CosNF::Filter_ptr filter = CosNF::Filter::_nil();
+
+  if (evs_ptr) {
+    CORBA::Boolean filt_err = sample_add_filter(channel, proxy, *evs_ptr, constraint_expr, objnm, filter, 0);
+    if (filt_err) {
+      try {
+	admin->destroy();
+      } catch (...) { }
+      return 0; // adding filter failed
+    }
+  }
+
+  // Construct a client
+  SequencePushSupplier_i* client =
+    new SequencePushSupplier_i(proxy, admin, filter, objnm, change_fn);
+  return client;
+}
+
+void SequencePushSupplier_i::push(const CosN::EventBatch& batch)
+{
+    _my_proxy->push_structured_events(batch);
+}
+
+void SequencePushSupplier_i::disconnect_sequence_push_supplier()
+{
+}
+
+CORBA::Boolean SequencePushSupplier_i::connect() {
+  try {
+    _my_proxy->connect_sequence_push_supplier(_this());
+    if (_change_fn) {
+      _my_proxy->obtain_subscription_types(CosNCA::NONE_NOW_UPDATES_ON);
+    } else {
+      _my_proxy->obtain_subscription_types(CosNCA::NONE_NOW_UPDATES_OFF);
+    }
+  } catch (CORBA::BAD_PARAM& ex) {
+    cerr << _obj_name << ": BAD_PARAM Exception while connecting" << endl;
+    return 1; // error
+  } catch (CosECA::AlreadyConnected& ex) {
+    cerr << _obj_name << ": Already connected" << endl;
+    return 1; // error
+  } catch (...) {
+    cerr << _obj_name << ": Failed to connect" << endl;
+    return 1; // error
+  }
+  // register the types to be supplied
+  offer_any(_my_proxy, _obj_name, _verbose);
+  return 0; // OK
+}
+
+void SequencePushSupplier_i::cleanup() {
+  CosNCA::SequenceProxyPushConsumer_var proxy;
+  proxy = _my_proxy;
+  _my_proxy = CosNCA::SequenceProxyPushConsumer::_nil();
+ 
+  try {
+    if (!CORBA::is_nil(proxy))
+      proxy->disconnect_sequence_push_consumer();
+  } 
+  catch(...) {
+
+  }
+  try {
+    _my_admin->destroy();
+  } 
+  catch (...) { 
+  
+  }
+  _my_admin = CosNCA::SupplierAdmin::_nil();
+  destroy_filters(_my_filters);
+}
+
+void SequencePushSupplier_i::subscription_change(const CosN::EventTypeSeq& added,
+					 const CosN::EventTypeSeq& deled)
+{
+  static CORBA::ULong events;
+  if (_change_fn) 
+      (*_change_fn)(added, deled, _obj_name, events++, _verbose);
+  else if (_verbose) 
+      cout << _obj_name << ": subscription_change received [# " << events << "]" << endl;
+}
+
 CosNCA::ProxySupplier_ptr get_proxy_supplier(CORBA::ORB_ptr orb,
 					   CosNCA::EventChannel_ptr channel,
 					   CosNCA::ClientType ctype,
@@ -397,6 +513,14 @@ CORBA::Boolean PushConsumer_i::connect() {
   return 0; // OK
 }
 
+// the filter given by 'create()', its constraints may be changed later
+//
+CosNF::Filter_ptr PushConsumer_i::filter() const {
+  if (0 == _my_filters.length())
+    return CosNF::Filter::_nil();
+  return _my_filters[0].in();
+}
+
 void PushConsumer_i::cleanup() {
   CosNCA::StructuredProxyPushSupplier_var proxy;
   
@@ -441,6 +565,302 @@ void PushConsumer_i::offer_change(const CosN::EventTypeSeq& added,
       cout << _obj_name << ": subscription_change received [# " << _recvEvents << "]" << endl;
 }
 
+// ==================== SequencePushConsumer_i ===================
+//
+
+SequencePushConsumer_i::
+SequencePushConsumer_i(CosNCA::SequenceProxyPushSupplier_ptr proxy,
+	       CosNCA::ConsumerAdmin_ptr admin,
+	       CosNF::Filter_ptr filter,
+	       const char* objnm,
+	       consume_batch_fn* consume_func, 
+           type_change_fn* change_fn) :
+  _my_proxy(proxy), _my_admin(admin), _my_filters(0),
+  _obj_name(objnm), _consume_fn(consume_func), _change_fn(change_fn), _verbose(0),
+  _recvEvents(0)
+{
+  if (! CORBA::is_nil(filter)) {
+    _my_filters.length(1);
+    _my_filters[0] = filter;
+  }
+}
+
+SequencePushConsumer_i*
+SequencePushConsumer_i::create(CORBA::ORB_ptr orb,
+		       CosNCA::EventChannel_ptr channel,
+		       const char* objnm,
+		       consume_batch_fn* consume_func,
+		       type_change_fn* change_fn,
+		       CosN::EventTypeSeq* evs_ptr,
+		       const char* constraint_expr)
+{
+  // Obtain appropriate proxy object
+  CosNCA::ConsumerAdmin_ptr admin = CosNCA::ConsumerAdmin::_nil();
+  CosNCA::ProxySupplier_var generic_proxy =
+    get_proxy_supplier(orb, channel, CosNCA::SEQUENCE_EVENT, 1, admin, 0); // 1 means push 0 means pull
+  CosNCA::SequenceProxyPushSupplier_ptr proxy = CosNCA::SequenceProxyPushSupplier::_narrow(generic_proxy);
+  if ( CORBA::is_nil(proxy) ) {
+    return 0; // get_proxy_supplier failed
+  }
+
+  // If evs or constraint_expr are non-empty, add a filter to proxy
+  CosNF::Filter_ptr filter = CosNF::Filter::_nil();
+
+  if (evs_ptr) {
+    CORBA::Boolean filt_err = sample_add_filter(channel, proxy, *evs_ptr, constraint_expr, objnm, filter, 0);
+    if (filt_err) {
+      try {
+	admin->destroy();
+      } catch (...) { }
+      return 0; // adding filter failed
+    }
+  }
+
+  // Construct a client
+  SequencePushConsumer_i* client =
+    new SequencePushConsumer_i(proxy, admin, filter, objnm, consume_func, change_fn);
+  return client;
+}
+
+CORBA::Boolean SequencePushConsumer_i::connect() {
+  try {
+    _my_proxy->connect_sequence_push_consumer(_this());
+    if (_change_fn) {
+      _my_proxy->obtain_offered_types(CosNCA::NONE_NOW_UPDATES_ON);
+    } else {
+      _my_proxy->obtain_offered_types(CosNCA::NONE_NOW_UPDATES_OFF);
+    }
+  } 
+  catch (CORBA::BAD_PARAM& ex) {
+    cerr << _obj_name << ": BAD_PARAM Exception while connecting" << endl;
+    return 1; // error
+  } 
+  catch (CosECA::AlreadyConnected& ex) {
+    cerr << _obj_name << ": Already connected" << endl;
+    return 1; // error
+  } 
+  catch (...) {
+    cerr << _obj_name << ": Failed to connect" << endl;
+    return 1; // error
+  }
+  if (_verbose) cout << _obj_name << ": Connected to proxy, ready to consume events" << endl;
+  return 0; // OK
+}
+
+// such as 'MaximumBatchSize' and 'PacingInterval' of the proxy
+//
+CORBA::Boolean SequencePushConsumer_i::set_qos(const CosN::QoSProperties& qos) {
+  try {
+    _my_proxy->set_qos(qos);
+  }
+  catch (CosN::UnsupportedQoS& ex) {
+    cerr << _obj_name << ": Unsupported QoS" << endl;
+    return 1; // error
+  }
+  catch (...) {
+    cerr << _obj_name << ": Failed to set QoS" << endl;
+    return 1; // error
+  }
+  return 0; // OK
+}
+
+// the filter given by 'create()', its constraints may be changed later
+//
+CosNF::Filter_ptr SequencePushConsumer_i::filter() const {
+  if (0 == _my_filters.length())
+    return CosNF::Filter::_nil();
+  return _my_filters[0].in();
+}
+
+void SequencePushConsumer_i::cleanup() {
+  CosNCA::SequenceProxyPushSupplier_var proxy;
+  
+  proxy = _my_proxy;
+  _my_proxy = CosNCA::SequenceProxyPushSupplier::_nil();
+  
+  // do not hold oplock while invoking disconnect
+  try {
+      proxy->disconnect_sequence_push_supplier();
+  } 
+  catch(...) {
+  }
+  try {
+    _my_admin->destroy();
+  } 
+  catch (...) { 
+  }
+  _my_admin = CosNCA::ConsumerAdmin::_nil();
+  destroy_filters(_my_filters);
+}
+
+void SequencePushConsumer_i::push_structured_events(const CosN::EventBatch& data)
+{
+  if (_consume_fn)
+    (*_consume_fn)(data);
+  else 
+    if (_verbose) cout << _obj_name << ": event count = " << (_recvEvents += data.length()) << endl;
+}
+
+void SequencePushConsumer_i::disconnect_sequence_push_consumer()
+{
+}
+
+void SequencePushConsumer_i::offer_change(const CosN::EventTypeSeq& added,
+					 const CosN::EventTypeSeq& deled)
+{
+  if (_change_fn) 
+      (*_change_fn)(added, deled, _obj_name, 0, _verbose);
+  else if (_verbose) 
+      cout << _obj_name << ": subscription_change received [# " << _recvEvents << "]" << endl;
+}
+
+// ==================== SequencePullConsumer_i ===================
+//
+
+SequencePullConsumer_i::
+SequencePullConsumer_i(CosNCA::SequenceProxyPullSupplier_ptr proxy,
+	       CosNCA::ConsumerAdmin_ptr admin,
+	       CosNF::Filter_ptr filter,
+	       const char* objnm,
+           type_change_fn* change_fn) :
+  _my_proxy(proxy), _my_admin(admin), _my_filters(0),
+  _obj_name(objnm), _change_fn(change_fn), _verbose(0),
+  _recvEvents(0)
+{
+  if (! CORBA::is_nil(filter)) {
+    _my_filters.length(1);
+    _my_filters[0] = filter;
+  }
+}
+
+SequencePullConsumer_i*
+SequencePullConsumer_i::create(CORBA::ORB_ptr orb,
+		       CosNCA::EventChannel_ptr channel,
+		       const char* objnm,
+		       type_change_fn* change_fn,
+		       CosN::EventTypeSeq* evs_ptr,
+		       const char* constraint_expr)
+{
+  // Obtain appropriate proxy object
+  CosNCA::ConsumerAdmin_ptr admin = CosNCA::ConsumerAdmin::_nil();
+  CosNCA::ProxySupplier_var generic_proxy =
+    get_proxy_supplier(orb, channel, CosNCA::SEQUENCE_EVENT, 0, admin, 0); // 1 means push 0 means pull
+  CosNCA::SequenceProxyPullSupplier_ptr proxy = CosNCA::SequenceProxyPullSupplier::_narrow(generic_proxy);
+  if ( CORBA::is_nil(proxy) ) {
+    return 0; // get_proxy_supplier failed
+  }
+
+  // If evs or constraint_expr are non-empty, add a filter to proxy
+  CosNF::Filter_ptr filter = CosNF::Filter::_nil();
+
+  if (evs_ptr) {
+    CORBA::Boolean filt_err = sample_add_filter(channel, proxy, *evs_ptr, constraint_expr, objnm, filter, 0);
+    if (filt_err) {
+      try {
+	admin->destroy();
+      } catch (...) { }
+      return 0; // adding filter failed
+    }
+  }
+
+  // Construct a client
+  SequencePullConsumer_i* client =
+    new SequencePullConsumer_i(proxy, admin, filter, objnm, change_fn);
+  return client;
+}
+
+CORBA::Boolean SequencePullConsumer_i::connect() {
+  try {
+    _my_proxy->connect_sequence_pull_consumer(_this());
+    if (_change_fn) {
+      _my_proxy->obtain_offered_types(CosNCA::NONE_NOW_UPDATES_ON);
+    } else {
+      _my_proxy->obtain_offered_types(CosNCA::NONE_NOW_UPDATES_OFF);
+    }
+  } 
+  catch (CORBA::BAD_PARAM& ex) {
+    cerr << _obj_name << ": BAD_PARAM Exception while connecting" << endl;
+    return 1; // error
+  } 
+  catch (CosECA::AlreadyConnected& ex) {
+    cerr << _obj_name << ": Already connected" << endl;
+    return 1; // error
+  } 
+  catch (...) {
+    cerr << _obj_name << ": Failed to connect" << endl;
+    return 1; // error
+  }
+  if (_verbose) cout << _obj_name << ": Connected to proxy, ready to consume events" << endl;
+  return 0; // OK
+}
+
+// such as 'MaxEventsPerConsumer' of the proxy
+//
+CORBA::Boolean SequencePullConsumer_i::set_qos(const CosN::QoSProperties& qos) {
+  try {
+    _my_proxy->set_qos(qos);
+  }
+  catch (CosN::UnsupportedQoS& ex) {
+    cerr << _obj_name << ": Unsupported QoS" << endl;
+    return 1; // error
+  }
+  catch (...) {
+    cerr << _obj_name << ": Failed to set QoS" << endl;
+    return 1; // error
+  }
+  return 0; // OK
+}
+
+CosNF::Filter_ptr SequencePullConsumer_i::filter() const {
+  if (0 == _my_filters.length())
+    return CosNF::Filter::_nil();
+  return _my_filters[0].in();
+}
+
+void SequencePullConsumer_i::cleanup() {
+  CosNCA::SequenceProxyPullSupplier_var proxy;
+  
+  proxy = _my_proxy;
+  _my_proxy = CosNCA::SequenceProxyPullSupplier::_nil();
+  
+  // do not hold oplock while invoking disconnect
+  try {
+      proxy->disconnect_sequence_pull_supplier();
+  } 
+  catch(...) {
+  }
+  try {
+    _my_admin->destroy();
+  } 
+  catch (...) { 
+  }
+  _my_admin = CosNCA::ConsumerAdmin::_nil();
+  destroy_filters(_my_filters);
+}
+
+// never blocks, 'hasEvent' is false if the channel holds none
+//
+CosN::EventBatch* SequencePullConsumer_i::pull(CORBA::Long max, CORBA::Boolean& hasEvent)
+{
+  CosN::EventBatch* batch = _my_proxy->try_pull_structured_events(max, hasEvent);
+  if (hasEvent && _verbose) 
+    cout << _obj_name << ": event count = " << (_recvEvents += batch->length()) << endl;
+  return batch;
+}
+
+void SequencePullConsumer_i::disconnect_sequence_pull_consumer()
+{
+}
+
+void SequencePullConsumer_i::offer_change(const CosN::EventTypeSeq& added,
+					 const CosN::EventTypeSeq& deled)
+{
+  if (_change_fn) 
+      (*_change_fn)(added, deled, _obj_name, 0, _verbose);
+  else if (_verbose) 
+      cout << _obj_name << ": subscription_change received [# " << _recvEvents << "]" << endl;
+}
+
 #if 0
 // ==================== PushSupplier_i ===================
 //
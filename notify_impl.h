@@ -4,6 +4,7 @@
 #include "cos.h"
 
 typedef void consume_fn(const CosN::StructuredEvent&);
+typedef void consume_batch_fn(const CosN::EventBatch&);
 typedef void type_change_fn(const CosN::EventTypeSeq& added,
                             const CosN::EventTypeSeq& deled,
                             const char* objName,
@@ -58,6 +59,47 @@ protected:
 };
 
 
+// the batching counterpart of PushSupplier_i, one remote call
+// to the channel carries a whole 'EventBatch'
+//
+class SequencePushSupplier_i : public POA_CosNotifyComm::SequencePushSupplier
+                             , public PortableServer::RefCountServantBase
+{
+private:
+    SequencePushSupplier_i( CosNCA::SequenceProxyPushConsumer_ptr proxy, 
+                            CosNCA::SupplierAdmin_ptr admin, 
+                            CosNF::Filter_ptr filter,
+                            const char* objnm, 
+                            type_change_fn* change_fn);
+public:
+    static 
+    SequencePushSupplier_i* create(CORBA::ORB_ptr orb,
+                                   CosNCA::EventChannel_ptr channel,
+                                   const char* objnm,
+                                   type_change_fn* change_fn,
+                                   CosN::EventTypeSeq* evs_ptr = 0,
+                                   const char* constraint_expr = "");
+
+    // IDL methods
+    void disconnect_sequence_push_supplier();
+    void subscription_change(const CosN::EventTypeSeq& added,
+                             const CosN::EventTypeSeq& deled);
+  
+    // Local methods
+    CORBA::Boolean connect();
+    void  cleanup();
+    void push(const CosN::EventBatch&);
+
+protected:
+    CosNCA::SequenceProxyPushConsumer_var _my_proxy;
+    CosNCA::SupplierAdmin_var     _my_admin;
+    FilterSeq                   _my_filters;
+    const char*                 _obj_name;
+    type_change_fn*             _change_fn;
+    CORBA::Boolean              _verbose;
+};
+
+
 class PushConsumer_i : public POA_CosNotifyComm::StructuredPushConsumer,
   public PortableServer::RefCountServantBase
 {
@@ -87,6 +129,7 @@ public:
   // Local methods
   CORBA::Boolean connect();
   void  cleanup();
+  CosNF::Filter_ptr filter() const;     // not duplicated, may be nil
 
 protected:
   CosNCA::StructuredProxyPushSupplier_var _my_proxy;
@@ -99,4 +142,94 @@ protected:
   CORBA::ULong                  _recvEvents;
 };
 
+// the batching counterpart of PushConsumer_i, the channel delivers
+// up to 'MaximumBatchSize' events per call (please refer to 'set_qos')
+//
+class SequencePushConsumer_i : public POA_CosNotifyComm::SequencePushConsumer,
+  public PortableServer::RefCountServantBase
+{
+public:
+  SequencePushConsumer_i(CosNCA::SequenceProxyPushSupplier_ptr proxy, 
+                         CosNCA::ConsumerAdmin_ptr admin, 
+                         CosNF::Filter_ptr filter,
+                         const char* objnm, 
+                         consume_batch_fn* consume_func,
+                         type_change_fn* change_fn);
+
+  static SequencePushConsumer_i* 
+  create(CORBA::ORB_ptr orb,
+         CosNCA::EventChannel_ptr channel,
+         const char* objnm,
+         consume_batch_fn* consume_func,
+         type_change_fn* change_fn,
+         CosN::EventTypeSeq* evs_ptr = 0,
+         const char* constraint_expr = "");
+
+  // IDL methods
+  void push_structured_events(const CosN::EventBatch& data);
+  void disconnect_sequence_push_consumer();
+  void offer_change(const CosN::EventTypeSeq& added,
+                    const CosN::EventTypeSeq& deled);
+
+  // Local methods
+  CORBA::Boolean connect();
+  CORBA::Boolean set_qos(const CosN::QoSProperties& qos);
+  void  cleanup();
+  CosNF::Filter_ptr filter() const;     // not duplicated, may be nil
+
+protected:
+  CosNCA::SequenceProxyPushSupplier_var _my_proxy;
+  CosNCA::ConsumerAdmin_var     _my_admin;
+  FilterSeq                     _my_filters;
+  const char*                   _obj_name;
+  consume_batch_fn*             _consume_fn;
+  type_change_fn*               _change_fn;
+  CORBA::Boolean                _verbose;
+  CORBA::ULong                  _recvEvents;
+};
+
+// a pull-mode consumer, the application drains up to 'max' events
+// per call on its own schedule; events it doesn't pull are held by
+// the channel (up to 'MaxEventsPerConsumer', please refer to 'set_qos')
+//
+class SequencePullConsumer_i : public POA_CosNotifyComm::SequencePullConsumer,
+  public PortableServer::RefCountServantBase
+{
+public:
+  SequencePullConsumer_i(CosNCA::SequenceProxyPullSupplier_ptr proxy, 
+                         CosNCA::ConsumerAdmin_ptr admin, 
+                         CosNF::Filter_ptr filter,
+                         const char* objnm, 
+                         type_change_fn* change_fn);
+
+  static SequencePullConsumer_i* 
+  create(CORBA::ORB_ptr orb,
+         CosNCA::EventChannel_ptr channel,
+         const char* objnm,
+         type_change_fn* change_fn,
+         CosN::EventTypeSeq* evs_ptr = 0,
+         const char* constraint_expr = "");
+
+  // IDL methods
+  void disconnect_sequence_pull_consumer();
+  void offer_change(const CosN::EventTypeSeq& added,
+                    const CosN::EventTypeSeq& deled);
+
+  // Local methods
+  CORBA::Boolean connect();
+  CORBA::Boolean set_qos(const CosN::QoSProperties& qos);
+  void  cleanup();
+  CosNF::Filter_ptr filter() const;     // not duplicated, may be nil
+  CosN::EventBatch* pull(CORBA::Long max, CORBA::Boolean& hasEvent);
+
+protected:
+  CosNCA::SequenceProxyPullSupplier_var _my_proxy;
+  CosNCA::ConsumerAdmin_var     _my_admin;
+  FilterSeq                     _my_filters;
+  const char*                   _obj_name;
+  type_change_fn*               _change_fn;
+  CORBA::Boolean                _verbose;
+  CORBA::ULong                  _recvEvents;
+};
+
 #endif
@@ -1,22 +1,357 @@
 #include <map>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <atomic>
 #include <string>
+#include <cstring>
+#include <random>
+#include <condition_variable>
 #include "provider.h"
 
-char* ProviderImpl::execCmd(const char* cmd, const char* inData)
+ProviderImpl::ProviderImpl(const char* hostId, const cc::Options& options)
+            : _cmdTable{std::make_shared<CmdTable>()}
+            , _epoch{[]() {
+                  std::random_device random;
+                  uint64_t epoch = (uint64_t(random()) << 32) ^ random() ^
+                  std::chrono::steady_clock::now().time_since_epoch().count();
+                  return 0 == epoch ? 1 : epoch;
+              }()}
 {
-    std::string             result;
-    auto                    which = _providerMap.find(std::string(cmd));
+    if (options.providerThreads > 0) {
+        cc::Scheduler::Limits limits = {
+            options.providerLimits.maxConcurrency,
+            options.providerLimits.queueSize
+        };
+        _scheduler = 
+        std::make_unique<cc::Scheduler>(options.providerThreads, limits);
+
+        for (const auto& cmdLimits : options.cmdLimits) {
+            limits = { cmdLimits.second.maxConcurrency,
+                       cmdLimits.second.queueSize };
+            _scheduler->setLimits(cmdLimits.first, limits);
+        }
+    }
 
-    if (which != _providerMap.end() && nullptr != which->second)
-        result = (*which->second)(cmd, inData);
-    else
-        result = "";
+    if (options.sharedMemory) {
+        _shm = cc::ShmServer::create(hostId, options.shmSlots, 
+                                     options.shmSlotSize, options.shmThreads,
+            [this](bool binary, int32_t id, const char* cmd, 
+                   const char* data, size_t length, std::string& result) {
+                return binary ? invokeBin(id, cmd, data, length, result) :
+                                invoke(id, cmd, data, length, result);
+            });
+    }
+}
 
+// a shed request is refused with NO_RESOURCES, the requester knows
+// the provider is busy, not gone, and that the command wasn't run
+//
+char* ProviderImpl::execCmd(const char* cmd, const char* inData)
+{
+    std::string result;
+    if (!invoke(-1, cmd, inData, std::strlen(inData), result))
+        throw CORBA::NO_RESOURCES(0, CORBA::COMPLETED_NO);
     return CORBA::string_dup(result.c_str());
 }
 
+char* ProviderImpl::execCmdById(CORBA::Long id, 
+                                const char* cmd, const char* inData)
+{
+    std::string result;
+    if (!invoke(id, cmd, inData, std::strlen(inData), result))
+        throw CORBA::NO_RESOURCES(0, CORBA::COMPLETED_NO);
+    return CORBA::string_dup(result.c_str());
+}
+
+char* ProviderImpl::sharedMemory()
+{
+    return CORBA::string_dup(_shm ? _shm->segment().c_str() : "");
+}
+
+void ProviderImpl::postCmd(CORBA::Long id, const char* cmd, 
+                           const char* inData, const char* sender,
+                           CORBA::ULongLong epoch)
+{
+    // a command shed by the scheduler counts as processed, too,
+    // a flush waits for commands, not for their success
+    //
+    std::string result;
+    invoke(id, cmd, inData, std::strlen(inData), result);
+
+    // the sender counts commands posted to an incarnation before
+    // as lost, they aren't counted here
+    //
+    if (0 != epoch && _epoch != epoch)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(_processedMutex);
+        auto which = _processed.find(sender);
+        if (which == _processed.end())
+            which = _processed.emplace(sender, 0).first;
+        ++which->second;
+    }
+    _processedCv.notify_all();
+}
+
+CORBA::ULongLong ProviderImpl::waitProcessed(const char* sender, 
+                                             CORBA::ULongLong count,
+                                             CORBA::ULong timeoutMs,
+                                             CORBA::ULongLong& epoch)
+{
+    auto processed = [&]() -> uint64_t {
+        auto which = _processed.find(sender);
+        return which != _processed.end() ? which->second : 0;
+    };
+
+    // 'count' includes commands posted to an incarnation before,
+    // they'll never be processed
+    //
+    bool sameEpoch = 0 == epoch || _epoch == epoch;
+    epoch = _epoch;
+
+    std::unique_lock<std::mutex> lock(_processedMutex);
+    if (sameEpoch)
+        _processedCv.wait_for(lock, std::chrono::milliseconds(timeoutMs), 
+                              [&]() { return processed() >= count; });
+    return processed();
+}
+
+CorbaCommModule::ResultSeq* 
+ProviderImpl::execBatch(const CorbaCommModule::CommandSeq& cmds)
+{
+    CorbaCommModule::ResultSeq* results = new CorbaCommModule::ResultSeq;
+    results->length(cmds.length());
+
+    // a shed command's result is empty, the others' still count
+    //
+    std::string result;
+    for (CORBA::ULong i = 0; i < cmds.length(); ++i) {
+        if (!invoke(-1, cmds[i].cmd, cmds[i].param, 
+                    std::strlen(cmds[i].param), result))
+            result.clear();
+        (*results)[i] = CORBA::string_dup(result.c_str());
+    }
+
+    return results;
+}
+
+CorbaCommModule::Octets* 
+ProviderImpl::execBinCmd(const char* cmd, 
+                         const CorbaCommModule::Octets& inData)
+{
+    std::string result;
+    if (!invokeBin(-1, cmd, (const char*)inData.get_buffer(), 
+                   inData.length(), result))
+        throw CORBA::NO_RESOURCES(0, CORBA::COMPLETED_NO);
+
+    // the sequence owns (and later frees) the buffer
+    //
+    CORBA::ULong  outLength = result.size();
+    CORBA::Octet* outData   = CorbaCommModule::Octets::allocbuf(outLength);
+    std::memcpy(outData, result.data(), outLength);
+    return new CorbaCommModule::Octets(outLength, outLength, outData, true);
+}
+
 void ProviderImpl::onCmd(const char* cmd, 
                        cc::CommandCallback_t cmdCallback)
 {
-    _providerMap[std::string(cmd)] = cmdCallback;
+    updateCmdTable([&](CmdTable& table) {
+        table.entries[intern(table, cmd)].callback = cmdCallback;
+    });
+}
+
+void ProviderImpl::onBinCmd(const char* cmd, 
+                            cc::BinaryCommandCallback_t cmdCallback)
+{
+    updateCmdTable([&](CmdTable& table) {
+        table.entries[intern(table, cmd)].binCallback = cmdCallback;
+    });
+}
+
+void ProviderImpl::exempt(const char* cmd)
+{
+    updateCmdTable([&](CmdTable& table) {
+        table.entries[intern(table, cmd)].exempt = true;
+    });
+}
+
+bool ProviderImpl::invoke(CORBA::Long id, const char* cmd,
+                          const char* data, size_t length, 
+                          std::string& result)
+{
+    CmdSnapshot             table  = std::atomic_load(&_cmdTable);
+    const Entry*            which  = entry(table, id, cmd);
+
+    result.clear();
+    return dispatch(which, cmd, 
+                    [&]() { result = callCmd(which, data, length); });
+}
+
+bool ProviderImpl::invokeBin(CORBA::Long id, const char* cmd,
+                             const char* data, size_t length,
+                             std::string& result)
+{
+    CmdSnapshot             table  = std::atomic_load(&_cmdTable);
+    const Entry*            which  = entry(table, id, cmd);
+
+    result.clear();
+    return dispatch(which, cmd, 
+                    [&]() { result = callBinCmd(which, data, length); });
+}
+
+std::string ProviderImpl::callLocal(CORBA::Long id, const char* cmd,
+                                    const char* data, size_t length)
+{
+    CmdSnapshot table = std::atomic_load(&_cmdTable);
+    return callCmd(entry(table, id, cmd), data, length);
+}
+
+std::string ProviderImpl::callLocalBin(CORBA::Long id, const char* cmd,
+                                       const char* data, size_t length)
+{
+    CmdSnapshot table = std::atomic_load(&_cmdTable);
+    return callBinCmd(entry(table, id, cmd), data, length);
+}
+
+CORBA::Long ProviderImpl::provides(const char* cmd) const
+{
+    CmdSnapshot  table = std::atomic_load(&_cmdTable);
+    const Entry* which = entry(table, cmd);
+    if (nullptr == which || 
+        (nullptr == which->callback && nullptr == which->binCallback))
+        return -1;
+    return which - table->entries.data();
+}
+
+CORBA::Long ProviderImpl::intern(const char* cmd)
+{
+    CmdSnapshot table = std::atomic_load(&_cmdTable);
+    auto which = table->ids.find(cmd);
+    if (which != table->ids.end())
+        return which->second;
+
+    CORBA::Long id;
+    updateCmdTable([&](CmdTable& next) { id = intern(next, cmd); });
+    return id;
+}
+
+// static
+CORBA::Long ProviderImpl::intern(CmdTable& table, const char* cmd)
+{
+    auto which = table.ids.find(cmd);
+    if (which != table.ids.end())
+        return which->second;
+
+    CORBA::Long id = table.entries.size();
+    table.ids.emplace(cmd, id);
+    table.entries.push_back({cmd, nullptr, nullptr, false});
+    return id;
+}
+
+// copy the current table, let 'modify' change the copy,
+// then publish the copy
+//
+template <typename Modifier>
+void ProviderImpl::updateCmdTable(Modifier modify)
+{
+    std::lock_guard<std::mutex> lock(_cmdTableMutex);
+    auto next = std::make_shared<CmdTable>(*std::atomic_load(&_cmdTable));
+    modify(*next);
+    std::atomic_store(&_cmdTable, CmdSnapshot(std::move(next)));
+}
+
+const ProviderImpl::Entry* 
+ProviderImpl::entry(const CmdSnapshot& table, const char* cmd) const
+{
+    auto which = table->ids.find(cmd);
+    if (which == table->ids.end())
+        return nullptr;
+    return &table->entries[which->second];
+}
+
+// by index, unless 'id' is unknown or stale (it isn't 'cmd')
+//
+const ProviderImpl::Entry* 
+ProviderImpl::entry(const CmdSnapshot& table, 
+                    CORBA::Long id, const char* cmd) const
+{
+    if (id >= 0 && (size_t)id < table->entries.size() &&
+        0 == std::strcmp(table->entries[id].cmd.c_str(), cmd))
+        return &table->entries[id];
+    return entry(table, cmd);
+}
+
+// without a scheduler, or for an exempt command, 'job' runs on the
+// calling (ORB) thread; otherwise it's queued by command, and the
+// calling thread waits for it
+// returns false if the command's queue is full
+//
+// omniORB has no asynchronous method handling, a reply can't be sent
+// from another thread, so the ORB thread is held until the job is done;
+// what the scheduler bounds is the callbacks' concurrency, a request it
+// can't queue is refused at once rather than holding a thread, too
+//
+bool ProviderImpl::dispatch(const Entry* which, const char* cmd, 
+                            const std::function<void()>& job)
+{
+    if (!_scheduler || (nullptr != which && which->exempt)) {
+        job();
+        return true;
+    }
+
+    std::mutex              mutex;
+    std::condition_variable cv;
+    bool                    done = false;
+
+    bool queued = 
+    _scheduler->post(cmd, [&]() {
+        try {
+            job();
+        }
+        catch (...) {
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+        cv.notify_one();
+    });
+    if (!queued)
+        return false;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&]() { return done; });
+    return true;
+}
+
+std::string ProviderImpl::callCmd(const Entry* which, 
+                                  const char* data, size_t length)
+{
+    if (nullptr == which)
+        return "";
+    if (nullptr != which->callback)
+        return (*which->callback)(which->cmd, std::string(data, length));
+
+    // the command might be offered by 'onBinCmd()' only
+    //
+    if (nullptr != which->binCallback)
+        return (*which->binCallback)(which->cmd, data, length);
+
+    return "";
+}
+
+std::string ProviderImpl::callBinCmd(const Entry* which, 
+                                     const char* data, size_t length)
+{
+    if (nullptr == which)
+        return "";
+    if (nullptr != which->binCallback)
+        return (*which->binCallback)(which->cmd, data, length);
+
+    // the command might be offered by 'onCmd()' only
+    //
+    if (nullptr != which->callback)
+        return (*which->callback)(which->cmd, std::string(data, length));
+
+    return "";
 }
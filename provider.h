@@ -1,15 +1,24 @@
 #ifndef _PROVIDER_H
 #define _PROVIDER_H
 #include <map>
+#include <mutex>
+#include <memory>
+#include <cstdint>
 #include <string>
+#include <vector>
+#include <functional>
+#include <condition_variable>
 #include "corbaComm.hh"
 #include "corbaComm.h"
+#include "scheduler.h"
+#include "shmtransport.h"
 
 class ProviderImpl: public POA_CorbaCommModule::Provider
 {
 public:
-    ProviderImpl() { }
+    ProviderImpl(const char* hostId, const cc::Options& options);
     virtual ~ProviderImpl() { }
+    ProviderImpl() = delete;
     ProviderImpl(const ProviderImpl&) = delete;
     ProviderImpl(ProviderImpl&&) = delete;
     ProviderImpl& operator=(const ProviderImpl&) = delete;
@@ -19,14 +28,106 @@ public:
     // interface method(s)
     //
     char* execCmd(const char* cmd, const char* inData);
+    CorbaCommModule::ResultSeq* execBatch(const CorbaCommModule::CommandSeq&);
+    CorbaCommModule::Octets* execBinCmd(const char* cmd, 
+                                        const CorbaCommModule::Octets& inData);
+    char* execCmdById(CORBA::Long id, const char* cmd, const char* inData);
+    char* sharedMemory();
+    void  postCmd(CORBA::Long id, const char* cmd, const char* inData,
+                  const char* sender, CORBA::ULongLong epoch);
+    CORBA::ULongLong waitProcessed(const char* sender, CORBA::ULongLong count,
+                                   CORBA::ULong timeoutMs, 
+                                   CORBA::ULongLong& epoch);
 
     // class ProviderImpl's method(s)
     //
     void onCmd(const char* cmd, 
                cc::CommandCallback_t cmdCallback);
+    void onBinCmd(const char* cmd, 
+                  cc::BinaryCommandCallback_t cmdCallback);
+
+    // the library's own commands, e.g. the routing reply, are called
+    // on the ORB thread, they're never queued behind the applications'
+    // commands nor shed
+    //
+    void exempt(const char* cmd);
+
+    // the id of 'cmd', it's announced to requesters with the offer
+    //
+    CORBA::Long intern(const char* cmd);
+
+    // this incarnation of the provider, announced with the offers
+    //
+    uint64_t epoch() const { return _epoch; }
+
+    // a request of another process, 'id' may be -1 (look 'cmd' up by
+    // name); it's dispatched by the scheduler, 'invoke()' returns false
+    // if the request is shed (the command's queue is full), the servant
+    // raises CORBA::NO_RESOURCES then
+    //
+    bool invoke(CORBA::Long id, const char* cmd, 
+                const char* data, size_t length, std::string& result);
+    bool invokeBin(CORBA::Long id, const char* cmd, 
+                   const char* data, size_t length, std::string& result);
+
+    // for requesters in this process, the callback is called directly
+    // on the calling thread, no marshalling, no scheduler: a callback
+    // running on a scheduler worker may call a command of this process
+    // without waiting for a worker of its own
+    // 'provides()' returns the id of 'cmd', -1 if it has no callback
+    //
+    CORBA::Long provides(const char* cmd) const;
+    std::string callLocal(CORBA::Long id, const char* cmd, 
+                          const char* data, size_t length);
+    std::string callLocalBin(CORBA::Long id, const char* cmd, 
+                             const char* data, size_t length);
 
 private:
-    typedef std::map<std::string, cc::CommandCallback_t> ProviderMap;
-    ProviderMap _providerMap;
+    // commands are interned, an id is the index of 'entries'
+    // a published table is never modified (copy-on-write), the ORB
+    // threads look it up without '_cmdTableMutex'; loading the snapshot
+    // still takes one of libstdc++'s global shared_ptr pool mutexes,
+    // just for the reference count
+    //
+    struct Entry {
+        std::string                 cmd;
+        cc::CommandCallback_t       callback;
+        cc::BinaryCommandCallback_t binCallback;
+        bool                        exempt;     // from the scheduler
+    };
+    struct CmdTable {
+        std::map<std::string, CORBA::Long, std::less<>> ids;
+        std::vector<Entry>                              entries;
+    };
+    typedef std::shared_ptr<const CmdTable> CmdSnapshot;
+
+    template <typename Modifier>
+    void updateCmdTable(Modifier modify);
+    static CORBA::Long intern(CmdTable&, const char* cmd);
+    const Entry* entry(const CmdSnapshot&, const char* cmd) const;
+    const Entry* entry(const CmdSnapshot&, CORBA::Long id, 
+                       const char* cmd) const;
+
+    bool dispatch(const Entry*, const char* cmd, 
+                  const std::function<void()>& job);
+    std::string callCmd(const Entry*, const char* data, size_t length);
+    std::string callBinCmd(const Entry*, const char* data, size_t length);
+
+    CmdSnapshot    _cmdTable;
+    std::mutex     _cmdTableMutex;      // serializes writers only
+    std::unique_ptr<cc::Scheduler> _scheduler;
+
+    // commands posted by each sender and processed, for 'waitProcessed()'
+    // '_epoch' tells this incarnation of the provider from the ones
+    // before, a sender's count starts afresh with each
+    //
+    const uint64_t                               _epoch;
+    std::map<std::string, uint64_t, std::less<>> _processed;
+    std::mutex                                   _processedMutex;
+    std::condition_variable                      _processedCv;
+
+    // stopped first in the dtor, its threads call 'invoke()'
+    //
+    std::unique_ptr<cc::ShmServer> _shm;
 };
 #endif
@@ -0,0 +1,28 @@
+
+#include <memory>
+#include "providerref.h"
+
+cc::ProviderRef::ProviderRef(Ref ref, std::shared_ptr<ShmClient> shm)
+               : _ref{ref}
+               , _shm{std::move(shm)}
+{
+}
+
+// static
+cc::ProviderRef::Handle 
+cc::ProviderRef::hold(const std::shared_ptr<ProviderRef>& ref)
+{
+    if (!ref || CORBA::is_nil(ref->_ref))
+        return Handle();
+    return Handle(ref);
+}
+
+cc::ProviderRef::Handle::Handle(std::shared_ptr<ProviderRef> ref)
+                       : _ref{std::move(ref)}
+{
+}
+
+CorbaCommModule::Provider_ptr cc::ProviderRef::Handle::operator->() const
+{
+    return _ref->_ref.in();
+}
@@ -0,0 +1,63 @@
+#ifndef _PROVIDERREF_H
+#define _PROVIDERREF_H
+#include <memory>
+#include "corbaComm.hh"
+#include "corbaComm.h"
+#include "shmtransport.h"
+
+namespace cc {
+
+// a client's way to one provider, its object reference and, on the
+// same host, its shared memory
+//
+// omniORB keys GIOP connections by the provider's address, so every
+// reference to a provider shares one set of connections; a call in
+// flight has one of its own (omniORB's 'oneCallPerConnection'), up to
+// 'maxGIOPConnectionPerServer' ('Options::connectionsPerProvider')
+//
+class ProviderRef {
+public:
+    typedef CorbaCommModule::Provider_var Ref;
+
+    ProviderRef(Ref ref, std::shared_ptr<ShmClient> shm);
+
+    // the reference for one request, it keeps the reference alive
+    // while the request is in flight, even if the provider is dropped
+    //
+    class Handle {
+    public:
+        Handle() = default;
+        explicit Handle(std::shared_ptr<ProviderRef> ref);
+        Handle(Handle&&) = default;
+        CorbaCommModule::Provider_ptr operator->() const;
+        explicit operator bool() const { return nullptr != _ref; }
+
+        // the provider's shared memory, nullptr if it's on another host
+        //
+        ShmClient* shm() const { return _ref->_shm.get(); }
+
+        Handle(const Handle&) = delete;
+        Handle& operator=(const Handle&) = delete;
+        Handle& operator=(Handle&&) = delete;
+
+    private:
+        std::shared_ptr<ProviderRef> _ref;
+    };
+    static Handle hold(const std::shared_ptr<ProviderRef>& ref);
+
+    // Big-5 rules
+    ProviderRef() = delete;
+    ProviderRef(const ProviderRef&) = delete;
+    ProviderRef(ProviderRef&&) = delete;
+    ProviderRef& operator=(const ProviderRef&) = delete;
+    ProviderRef& operator=(ProviderRef&&) = delete;
+
+private:
+    Ref                        _ref;
+    std::shared_ptr<ShmClient> _shm;
+};
+
+};  // namespace cc
+
+#endif
+
@@ -0,0 +1,335 @@
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <thread>
+#include <chrono>
+#include "publishq.h"
+
+// a blocked publisher yields this many times, then sleeps between tries
+//
+static const unsigned blockSpins = 64;
+
+// events of a ring the sender sends before the other queues' turn
+//
+static const unsigned ringBatch  = 64;
+
+cc::PublishQueue::Ring::Ring(unsigned capacity)
+                      : _cells([capacity]() {
+                            size_t size = 2;
+                            while (size < capacity)
+                                size <<= 1;
+                            return size;
+                        }())
+                      , _mask(_cells.size() - 1)
+{
+    for (size_t i = 0; i < _cells.size(); ++i)
+        _cells[i].seq.store(i, std::memory_order_relaxed);
+}
+
+cc::PublishQueue::Ring::~Ring()
+{
+    CosN::StructuredEvent* event;
+    while (dequeue(event))
+        delete event;
+}
+
+bool cc::PublishQueue::Ring::enqueue(CosN::StructuredEvent* event)
+{
+    size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+    while (true) {
+        Cell&    cell = _cells[pos & _mask];
+        size_t   seq  = cell.seq.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (0 == diff) {
+            if (_enqueuePos.compare_exchange_weak(pos, pos + 1,
+                                                  std::memory_order_relaxed)) {
+                cell.event = event;
+                cell.seq.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0)
+            return false;
+        else
+            pos = _enqueuePos.load(std::memory_order_relaxed);
+    }
+}
+
+// false also if an enqueue is half done
+//
+bool cc::PublishQueue::Ring::dequeue(CosN::StructuredEvent*& event)
+{
+    size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+    while (true) {
+        Cell&    cell = _cells[pos & _mask];
+        size_t   seq  = cell.seq.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (0 == diff) {
+            if (_dequeuePos.compare_exchange_weak(pos, pos + 1,
+                                                  std::memory_order_relaxed)) {
+                event = cell.event;
+                cell.seq.store(pos + _mask + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0)
+            return false;
+        else
+            pos = _dequeuePos.load(std::memory_order_relaxed);
+    }
+}
+
+cc::PublishQueue::PublishQueue(unsigned capacity,
+                               cc::OverflowPolicy policy,
+                               const std::map<std::string,
+                                              cc::OverflowPolicy>& policies,
+                               cc::PublishQueue::Sender send)
+                : _policy(policy)
+                , _topicPolicies(policies)
+                , _send(std::move(send))
+                , _blockRing(capacity)
+                , _dropOldestRing(capacity)
+                , _dropNewestRing(capacity)
+                , _lookup{std::make_shared<SlotLookup>()}
+                , _stopping{false}
+{
+    _sender = std::thread([this]() { run(); });
+}
+
+cc::PublishQueue::~PublishQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _wake.notify_one();
+    _sender.join();
+
+    for (auto& slot : _slots)
+        delete slot.second->latest.exchange(nullptr);
+}
+
+bool cc::PublishQueue::push(const std::string& topic,
+                            const CosN::StructuredEvent& event)
+{
+    const cc::OverflowPolicy policy = policyOf(topic);
+    _enqueued.fetch_add(1, std::memory_order_relaxed);
+
+    // the slot's event is replaced, the slot is linked into the dirty
+    // list unless it's there already
+    //
+    if (cc::OverflowPolicy::conflate == policy) {
+        Slot* s = slot(topic);
+        CosN::StructuredEvent* prev =
+        s->latest.exchange(new CosN::StructuredEvent(event));
+        if (prev)
+            drop(prev);
+        if (!s->dirty.exchange(true)) {
+            _inFlight.fetch_add(1);
+            Slot* head = _dirty.load(std::memory_order_relaxed);
+            do {
+                s->next = head;
+            } while (!_dirty.compare_exchange_weak(head, s,
+                                                   std::memory_order_release,
+                                                   std::memory_order_relaxed));
+            wake();
+        }
+        return true;
+    }
+
+    CosN::StructuredEvent* copy = new CosN::StructuredEvent(event);
+    Ring&                  r    = *ring(policy);
+    _inFlight.fetch_add(1);
+    switch (policy) {
+    case cc::OverflowPolicy::dropNewest:
+        if (!r.enqueue(copy)) {
+            drop(copy);
+            _inFlight.fetch_sub(1);
+            return false;
+        }
+        break;
+    case cc::OverflowPolicy::dropOldest:
+        // only events of 'dropOldest' topics are in this ring
+        //
+        while (!r.enqueue(copy)) {
+            CosN::StructuredEvent* oldest;
+            if (r.dequeue(oldest)) {
+                drop(oldest);
+                _inFlight.fetch_sub(1);
+            }
+        }
+        break;
+    default:
+        for (unsigned spins = 0; !r.enqueue(copy); ++spins) {
+            if (spins < blockSpins)
+                std::this_thread::yield();
+            else
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        break;
+    }
+    wake();
+    return true;
+}
+
+void cc::PublishQueue::flush()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _wake.notify_one();
+    _drained.wait(lock, [this]() { return 0 == _inFlight.load(); });
+}
+
+cc::PublishStats cc::PublishQueue::stats() const
+{
+    return { _enqueued.load(std::memory_order_relaxed),
+             _sent.load(std::memory_order_relaxed),
+             _dropped.load(std::memory_order_relaxed),
+             _inFlight.load(std::memory_order_relaxed) };
+}
+
+cc::PublishQueue::Ring* cc::PublishQueue::ring(cc::OverflowPolicy policy)
+{
+    switch (policy) {
+    case cc::OverflowPolicy::dropOldest: return &_dropOldestRing;
+    case cc::OverflowPolicy::dropNewest: return &_dropNewestRing;
+    default:                             return &_blockRing;
+    }
+}
+
+// up to 'ringBatch' events, false if it had none
+//
+bool cc::PublishQueue::sendRing(Ring& r)
+{
+    unsigned               sent = 0;
+    CosN::StructuredEvent* event;
+    while (sent < ringBatch && r.dequeue(event)) {
+        send(event);
+        _inFlight.fetch_sub(1);
+        ++sent;
+    }
+    return sent > 0;
+}
+
+// the dirty list is taken whole, oldest first; a slot is unmarked
+// before its event is taken, so an event replacing it afterwards
+// links the slot again
+//
+bool cc::PublishQueue::sendSlots()
+{
+    Slot* head = _dirty.exchange(nullptr, std::memory_order_acquire);
+    if (nullptr == head)
+        return false;
+
+    Slot* oldest = nullptr;
+    while (head) {
+        Slot* next = head->next;
+        head->next = oldest;
+        oldest     = head;
+        head       = next;
+    }
+    while (oldest) {
+        Slot* next = oldest->next;
+        oldest->dirty.store(false);
+        CosN::StructuredEvent* event = oldest->latest.exchange(nullptr);
+        if (event)
+            send(event);
+        _inFlight.fetch_sub(1);
+        oldest = next;
+    }
+    return true;
+}
+
+bool cc::PublishQueue::send(CosN::StructuredEvent* event)
+{
+    bool sent = false;
+    try {
+        sent = _send(*event);
+    }
+    catch (...) {
+    }
+    (sent ? _sent : _dropped).fetch_add(1, std::memory_order_relaxed);
+    delete event;
+    return sent;
+}
+
+void cc::PublishQueue::drop(CosN::StructuredEvent* event)
+{
+    delete event;
+    _dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+// the lock is taken only if the sender sleeps
+//
+void cc::PublishQueue::wake()
+{
+    if (_idle.load()) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _wake.notify_one();
+    }
+}
+
+cc::PublishQueue::Slot* cc::PublishQueue::slot(const std::string& topic)
+{
+    auto lookup = std::atomic_load(&_lookup);
+    auto which  = lookup->find(topic);
+    if (which != lookup->end())
+        return which->second;
+
+    // a new topic, copy the lookup map and publish the copy
+    //
+    std::lock_guard<std::mutex> lock(_slotsMutex);
+    auto& s = _slots[topic];
+    if (!s) {
+        s = std::make_unique<Slot>();
+        auto copy = std::make_shared<SlotLookup>(*_lookup);
+        (*copy)[topic] = s.get();
+        std::atomic_store(&_lookup,
+                          std::shared_ptr<const SlotLookup>(std::move(copy)));
+    }
+    return s.get();
+}
+
+cc::OverflowPolicy cc::PublishQueue::policyOf(const std::string& topic) const
+{
+    auto which = _topicPolicies.find(topic);
+    return which != _topicPolicies.end() ? which->second : _policy;
+}
+
+// the queues take turns, a batch of events each
+//
+void cc::PublishQueue::run()
+{
+    while (true) {
+        bool busy = sendRing(_blockRing);
+        busy = sendRing(_dropOldestRing) || busy;
+        busy = sendRing(_dropNewestRing) || busy;
+        busy = sendSlots() || busy;
+        if (busy)
+            continue;
+
+        // '_idle' is set before '_inFlight' is checked, and publishers
+        // count an event before they check '_idle', so a wake-up can't
+        // be missed
+        //
+        std::unique_lock<std::mutex> lock(_mutex);
+        _idle.store(true);
+        if (_inFlight.load() > 0) {
+            // an event is being linked in
+            //
+            _idle.store(false);
+            lock.unlock();
+            std::this_thread::yield();
+            continue;
+        }
+
+        _drained.notify_all();
+        if (_stopping)
+            return;
+        _wake.wait(lock, [this]() {
+            return _stopping || _inFlight.load() > 0;
+        });
+        _idle.store(false);
+    }
+}
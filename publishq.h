@@ -0,0 +1,137 @@
+#ifndef _PUBLISHQ_H
+#define _PUBLISHQ_H
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+#include "cos.h"
+#include "corbaComm.h"
+
+namespace cc {
+
+// decouples publishers from the channel, a publisher only copies the
+// event into a bounded queue, a thread of the queue's own sends it
+//
+// each overflow policy has a queue of its own, so a full queue only
+// ever affects topics of the same policy:
+//   block      - a lock-free ring, the publisher waits for room
+//   dropOldest - a lock-free ring, its oldest event is dropped
+//   dropNewest - a lock-free ring, the new event is dropped
+//   conflate   - a slot per topic holding its latest unsent event,
+//                a newer event replaces it; it never waits
+//
+// a topic's events are sent in order, events of topics of different
+// policies may pass each other
+//
+class PublishQueue {
+public:
+    typedef std::function<bool(const CosN::StructuredEvent&)> Sender;
+
+    PublishQueue(unsigned capacity,     // of each ring
+                 OverflowPolicy policy,
+                 const std::map<std::string, OverflowPolicy>& topicPolicies,
+                 Sender send);
+    ~PublishQueue();                // sends what is left
+
+    // the event is copied, the caller may reuse it
+    // false if the event is dropped at once ('dropNewest')
+    //
+    bool push(const std::string& topic, const CosN::StructuredEvent&);
+
+    // waits until everything pushed before is sent (or dropped)
+    //
+    void flush();
+
+    PublishStats stats() const;
+
+    // Big-5 rules
+    PublishQueue() = delete;
+    PublishQueue(const PublishQueue&) = delete;
+    PublishQueue(PublishQueue&&) = delete;
+    PublishQueue& operator=(const PublishQueue&) = delete;
+    PublishQueue& operator=(PublishQueue&&) = delete;
+
+private:
+    // a bounded multi-producer multi-consumer ring (D. Vyukov's),
+    // its size is a power of 2
+    //
+    class Ring {
+    public:
+        explicit Ring(unsigned capacity);
+        ~Ring();
+        bool enqueue(CosN::StructuredEvent*);   // false if it's full
+        bool dequeue(CosN::StructuredEvent*&);  // false if it's empty
+    private:
+        struct Cell {
+            std::atomic<size_t>    seq;
+            CosN::StructuredEvent* event;
+        };
+        std::vector<Cell>   _cells;
+        const size_t        _mask;
+        std::atomic<size_t> _enqueuePos{0};
+        std::atomic<size_t> _dequeuePos{0};
+    };
+
+    // a conflated topic's latest unsent event; a slot with an event
+    // is linked into the dirty list once, until the sender takes it
+    //
+    struct Slot {
+        std::atomic<CosN::StructuredEvent*> latest{nullptr};
+        std::atomic<bool>                   dirty{false};
+        Slot*                               next{nullptr};
+    };
+    typedef std::map<std::string, Slot*, std::less<>> SlotLookup;
+
+    Ring* ring(OverflowPolicy);
+    bool  sendRing(Ring&);
+    bool  sendSlots();
+    bool  send(CosN::StructuredEvent*);
+    void  drop(CosN::StructuredEvent*);
+    void  wake();
+    Slot* slot(const std::string& topic);
+    OverflowPolicy policyOf(const std::string& topic) const;
+    void  run();
+
+    const OverflowPolicy                        _policy;
+    const std::map<std::string, OverflowPolicy> _topicPolicies;
+    Sender                                      _send;
+
+    Ring                                        _blockRing;
+    Ring                                        _dropOldestRing;
+    Ring                                        _dropNewestRing;
+
+    // conflated topics, slots are never removed, the lookup is copied
+    // on write; '_dirty' is a lock-free stack the sender takes whole
+    //
+    std::shared_ptr<const SlotLookup>           _lookup;
+    std::map<std::string, std::unique_ptr<Slot>> _slots;
+    std::mutex                                  _slotsMutex;
+    std::atomic<Slot*>                          _dirty{nullptr};
+
+    // the sender sleeps on '_wake' when it has nothing to send,
+    // 'flush()' on '_drained' until nothing is in flight
+    //
+    std::mutex                                  _mutex;
+    std::condition_variable                     _wake;
+    std::condition_variable                     _drained;
+    std::atomic<bool>                           _idle{false};
+    bool                                        _stopping;
+    std::thread                                 _sender;
+
+    // events in the rings, and slots in the dirty list
+    //
+    std::atomic<uint64_t>                       _inFlight{0};
+    std::atomic<uint64_t>                       _enqueued{0};
+    std::atomic<uint64_t>                       _sent{0};
+    std::atomic<uint64_t>                       _dropped{0};
+};
+
+};  // namespace cc
+
+#endif
@@ -0,0 +1,70 @@
+
+#include <list>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include "resultcache.h"
+
+cc::ResultCache::ResultCache(size_t capacity)
+               : _capacity{capacity}
+               , _hits{0}
+               , _misses{0}
+{
+}
+
+bool cc::ResultCache::get(cc::CmdId id, const std::string& param, 
+                          std::string& result)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto which = _index.find(Key(id, param));
+    if (which == _index.end()) {
+        ++_misses;
+        return false;
+    }
+
+    // expired entries are dropped lazily, on lookup or by LRU eviction
+    //
+    if (Clock::now() >= which->second->_expiry) {
+        _entries.erase(which->second);
+        _index.erase(which);
+        ++_misses;
+        return false;
+    }
+
+    _entries.splice(_entries.begin(), _entries, which->second);
+    result = which->second->_result;
+    ++_hits;
+    return true;
+}
+
+void cc::ResultCache::put(cc::CmdId id, const std::string& param,
+                          const std::string& result, 
+                          std::chrono::milliseconds ttl)
+{
+    if (0 == _capacity)
+        return;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    Key  key(id, param);
+    auto expiry = Clock::now() + ttl;
+    auto which  = _index.find(key);
+    if (which != _index.end()) {
+        which->second->_result = result;
+        which->second->_expiry = expiry;
+        _entries.splice(_entries.begin(), _entries, which->second);
+        return;
+    }
+
+    if (_entries.size() >= _capacity) {
+        _index.erase(_entries.back()._key);
+        _entries.pop_back();
+    }
+    _entries.push_front({key, result, expiry});
+    _index.emplace(std::move(key), _entries.begin());
+}
+
+cc::CacheStats cc::ResultCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return { _hits, _misses, _entries.size() };
+}
@@ -0,0 +1,60 @@
+#ifndef _RESULT_CACHE_H
+#define _RESULT_CACHE_H
+#include <list>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <utility>
+#include <functional>
+#include <unordered_map>
+#include "corbaComm.h"
+
+namespace cc {
+
+// a bounded cache of command results, keyed by (command, param)
+// an entry lives until its TTL expires or it's the least recently
+// used one when the cache is full
+//
+class ResultCache {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    explicit ResultCache(size_t capacity);
+
+    bool get(CmdId id, const std::string& param, std::string& result);
+    void put(CmdId id, const std::string& param, 
+             const std::string& result, std::chrono::milliseconds ttl);
+    CacheStats stats() const;
+
+    // Big-5 rules
+    ResultCache() = delete;
+    ResultCache(const ResultCache&) = delete;
+    ResultCache(ResultCache&&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+    ResultCache& operator=(ResultCache&&) = delete;
+
+private:
+    typedef std::pair<CmdId, std::string> Key;
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return std::hash<std::string>()(key.second) * 31 + key.first;
+        }
+    };
+    struct Entry {
+        Key                 _key;
+        std::string         _result;
+        Clock::time_point   _expiry;
+    };
+    typedef std::list<Entry>    Entries;    // most recently used first
+
+    Entries                                                 _entries;
+    std::unordered_map<Key, Entries::iterator, KeyHash>     _index;
+    size_t                                                  _capacity;
+    uint64_t                                                _hits;
+    uint64_t                                                _misses;
+    mutable std::mutex                                      _mutex;
+};
+
+};  // namespace cc
+
+#endif
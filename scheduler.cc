@@ -0,0 +1,130 @@
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "scheduler.h"
+
+cc::Scheduler::Scheduler(unsigned threads, const Limits& defaults)
+             : _defaults(defaults)
+             , _stopping{false}
+{
+    if (0 == threads)
+        threads = 1;
+    for (unsigned i = 0; i < threads; ++i)
+        _workers.emplace_back([this]() { run(); });
+}
+
+cc::Scheduler::~Scheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _cv.notify_all();
+    for (auto& worker : _workers)
+        worker.join();
+}
+
+void cc::Scheduler::setLimits(const std::string& key, const Limits& limits)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _limits[key] = limits;
+
+    auto which = _queues.find(key);
+    if (which != _queues.end()) {
+        which->second._limits = limits;
+        if (makeReady(which->second))
+            _cv.notify_one();
+    }
+}
+
+bool cc::Scheduler::post(const std::string& key, cc::Scheduler::Job job)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Queue& q = queue(key);
+        if (q._limits.queueSize > 0 && q._jobs.size() >= q._limits.queueSize)
+            return false;
+
+        q._jobs.push_back(std::move(job));
+        if (!makeReady(q))
+            return true;
+    }
+    _cv.notify_one();
+    return true;
+}
+
+// must be called with '_mutex' locked
+//
+cc::Scheduler::Queue& cc::Scheduler::queue(const std::string& key)
+{
+    auto which = _queues.find(key);
+    if (which == _queues.end()) {
+        auto limits = _limits.find(key);
+        Queue q;
+        q._limits  = limits != _limits.end() ? limits->second : _defaults;
+        q._running = 0;
+        q._ready   = false;
+        which = _queues.emplace(key, std::move(q)).first;
+    }
+    return which->second;
+}
+
+// must be called with '_mutex' locked
+// put the queue at the end of the ready list if it has a job to run,
+// returns true if it is newly added
+//
+bool cc::Scheduler::makeReady(Queue& q)
+{
+    if (q._ready || q._jobs.empty())
+        return false;
+    if (q._limits.maxConcurrency > 0 && 
+        q._running >= q._limits.maxConcurrency)
+        return false;
+
+    q._ready = true;
+    _ready.push_back(&q);
+    return true;
+}
+
+void cc::Scheduler::run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _cv.wait(lock, [this]() { return _stopping || !_ready.empty(); });
+
+        // drain what is left before leaving
+        //
+        if (_ready.empty())
+            return;
+
+        Queue* q = _ready.front();
+        _ready.pop_front();
+        q->_ready = false;
+
+        Job job = std::move(q->_jobs.front());
+        q->_jobs.pop_front();
+        ++q->_running;
+
+        // its next job waits for its next turn
+        //
+        if (makeReady(*q))
+            _cv.notify_one();
+
+        lock.unlock();
+        try {
+            job();
+        }
+        catch (...) {
+            // a job must never take a worker down
+            //
+        }
+        lock.lock();
+
+        --q->_running;
+        if (makeReady(*q))
+            _cv.notify_one();
+    }
+}
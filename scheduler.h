@@ -0,0 +1,66 @@
+#ifndef _SCHEDULER_H
+#define _SCHEDULER_H
+#include <map>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+namespace cc {
+
+// a thread pool with one bounded FIFO queue per key (per command)
+// keys with pending jobs take turns (round-robin), so a burst of
+// slow jobs of one key can't starve the others, and at most
+// 'maxConcurrency' jobs of a key run at the same time
+//
+class Scheduler {
+public:
+    typedef std::function<void()> Job;
+    struct Limits {
+        unsigned maxConcurrency;    // 0: no limit but the thread count
+        unsigned queueSize;         // 0: unbounded
+    };
+
+    Scheduler(unsigned threads, const Limits& defaults);
+    ~Scheduler();
+
+    void setLimits(const std::string& key, const Limits& limits);
+
+    // false if the key's queue is full, the job is dropped
+    //
+    bool post(const std::string& key, Job job);
+
+    // Big-5 rules
+    Scheduler() = delete;
+    Scheduler(const Scheduler&) = delete;
+    Scheduler(Scheduler&&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+    Scheduler& operator=(Scheduler&&) = delete;
+
+private:
+    struct Queue {
+        std::deque<Job> _jobs;
+        Limits          _limits;
+        unsigned        _running;
+        bool            _ready;
+    };
+    Queue& queue(const std::string& key);
+    bool   makeReady(Queue&);
+    void   run();
+
+    std::map<std::string, Queue> _queues;
+    std::map<std::string, Limits> _limits;
+    std::deque<Queue*>           _ready;
+    Limits                       _defaults;
+    std::vector<std::thread>     _workers;
+    std::mutex                   _mutex;
+    std::condition_variable      _cv;
+    bool                         _stopping;
+};
+
+};  // namespace cc
+
+#endif
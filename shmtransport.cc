@@ -0,0 +1,468 @@
+
+#include <new>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+#include "shmtransport.h"
+
+#ifdef __linux__
+
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+namespace {
+
+const uint32_t shmMagic   = 0x43434d53;       // "CCMS"
+const uint32_t shmVersion = 3;
+const size_t   cmdSize    = 128;
+const unsigned waitSliceMs = 100;             // between liveness checks
+
+// a slot's life
+// requester: free -> claimed -> request
+// provider:  request -> serving -> (responseMore <-> continue)* -> response
+// requester: response -> free
+// a requester which gives up marks the slot 'abandoned',
+// the provider frees it
+//
+// a claimed slot's state is 'slotClaimed' | the requester's pid, the
+// claim and its owner are one compare-and-swap: a requester which dies
+// before its request is published leaves a slot that can be taken back
+// (pids are below 2^22 on Linux, the flag bit is never a pid's)
+//
+const uint32_t slotClaimed = 0x80000000u;
+
+enum SlotState : uint32_t {
+    slotFree,
+    slotRequest,
+    slotServing,
+    slotResponseMore,
+    slotContinue,
+    slotResponse,
+    slotAbandoned
+};
+
+struct Header {
+    uint32_t              magic;
+    uint32_t              version;
+    uint64_t              nonce;
+    uint32_t              slots;
+    uint32_t              slotSize;
+    int32_t               pid;              // the provider's
+    std::atomic<uint32_t> doorbell;         // bumped for every request
+    std::atomic<uint32_t> stopping;
+};
+
+struct Slot {
+    std::atomic<uint32_t> state;            // a futex word, too
+    std::atomic<int32_t>  pid;              // the requester's
+    uint32_t              binary;
+    uint32_t              shed;             // the response: overloaded
+    int32_t               cmdId;
+    uint32_t              length;           // of the data
+    char                  cmd[cmdSize];
+    // followed by 'slotSize' bytes of data
+};
+
+size_t align(size_t size)
+{
+    return (size + 63) & ~size_t(63);
+}
+
+size_t headerSize()
+{
+    return align(sizeof(Header));
+}
+
+size_t slotStride(uint32_t slotSize)
+{
+    return align(sizeof(Slot) + slotSize);
+}
+
+size_t segmentSize(uint32_t slots, uint32_t slotSize)
+{
+    return headerSize() + slots * slotStride(slotSize);
+}
+
+Header* headerOf(void* base)
+{
+    return static_cast<Header*>(base);
+}
+
+Slot* slotOf(void* base, unsigned which)
+{
+    Header* header = headerOf(base);
+    return reinterpret_cast<Slot*>(static_cast<char*>(base) + headerSize() +
+                                   which * slotStride(header->slotSize));
+}
+
+char* dataOf(Slot* slot)
+{
+    return reinterpret_cast<char*>(slot + 1);
+}
+
+// the futex words are shared between processes, no FUTEX_PRIVATE_FLAG
+//
+void futexWait(std::atomic<uint32_t>* word, uint32_t expected, unsigned ms)
+{
+    timespec timeout = { time_t(ms / 1000), long(ms % 1000) * 1000000 };
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT,
+            expected, &timeout, nullptr, 0);
+}
+
+void futexWake(std::atomic<uint32_t>* word, int count)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE,
+            count, nullptr, nullptr, 0);
+}
+
+bool alive(int32_t pid)
+{
+    return 0 == kill(pid, 0) || errno != ESRCH;
+}
+
+// a slot left by a dead requester: claimed, but never requested, or
+// answered, but never taken
+//
+bool orphaned(uint32_t state, const Slot* slot)
+{
+    if (0 != (state & slotClaimed))
+        return !alive(int32_t(state & ~slotClaimed));
+    return slotResponse == state && !alive(slot->pid);
+}
+
+}   // namespace
+
+std::unique_ptr<cc::ShmServer>
+cc::ShmServer::create(const std::string& hostId, unsigned slots,
+                      unsigned slotSize, unsigned threads, Handler handler)
+{
+    if (0 == slots || 0 == slotSize)
+        return nullptr;
+
+    std::string name = "/corbaComm." + hostId;
+    std::replace(name.begin() + 1, name.end(), '/', '_');
+
+    // a segment left by a crashed provider of the same host id
+    //
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+        return nullptr;
+
+    size_t size = segmentSize(slots, slotSize);
+    void*  base = MAP_FAILED;
+    if (0 == ftruncate(fd, size))
+        base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == base) {
+        shm_unlink(name.c_str());
+        return nullptr;
+    }
+
+    // a requester on another host (or of a stale segment) can't
+    // guess the nonce
+    //
+    std::random_device random;
+    Header* header   = new (base) Header;
+    header->magic    = shmMagic;
+    header->version  = shmVersion;
+    header->nonce    = (uint64_t(random()) << 32) | random();
+    header->slots    = slots;
+    header->slotSize = slotSize;
+    header->pid      = getpid();
+    header->doorbell = 0;
+    header->stopping = 0;
+    for (unsigned i = 0; i < slots; ++i) {
+        Slot* slot  = new (slotOf(base, i)) Slot;
+        slot->state = slotFree;
+    }
+
+    std::unique_ptr<ShmServer> server(new ShmServer(name, base, size,
+                                                    std::move(handler)));
+    server->_segment = name + ";" + std::to_string(header->nonce);
+    for (unsigned i = 0; i < std::max(threads, 1u); ++i)
+        server->_workers.emplace_back([s = server.get()]() { s->run(); });
+    return server;
+}
+
+cc::ShmServer::ShmServer(const std::string& name, void* base, size_t size,
+                         Handler handler)
+             : _name{name}
+             , _base{base}
+             , _size{size}
+             , _handler{std::move(handler)}
+{
+}
+
+cc::ShmServer::~ShmServer()
+{
+    Header* header = headerOf(_base);
+    header->stopping = 1;
+    header->doorbell.fetch_add(1);
+    futexWake(&header->doorbell, INT_MAX);
+    for (auto& worker : _workers)
+        worker.join();
+
+    munmap(_base, _size);
+    shm_unlink(_name.c_str());
+}
+
+void cc::ShmServer::run()
+{
+    Header*  header = headerOf(_base);
+    unsigned next   = 0;
+    while (0 == header->stopping.load()) {
+        // the doorbell is read before the slots are scanned,
+        // a request rung in meanwhile doesn't let the worker sleep
+        //
+        uint32_t bell   = header->doorbell.load();
+        bool     served = false;
+        for (unsigned i = 0; i < header->slots && !served; ++i) {
+            unsigned which    = (next + i) % header->slots;
+            uint32_t expected = slotRequest;
+            if (slotOf(_base, which)->state.compare_exchange_strong(
+                                                expected, slotServing)) {
+                next   = which + 1;
+                served = true;
+                serve(which);
+            }
+        }
+        if (!served)
+            futexWait(&header->doorbell, bell, waitSliceMs);
+    }
+}
+
+void cc::ShmServer::serve(unsigned which)
+{
+    Header* header = headerOf(_base);
+    Slot*   slot   = slotOf(_base, which);
+    char*   data   = dataOf(slot);
+
+    std::string result;
+    bool        served = true;
+    try {
+        served = _handler(0 != slot->binary, slot->cmdId, slot->cmd,
+                          data, slot->length, result);
+    }
+    catch (...) {
+        // a handler must never take a worker down
+        //
+    }
+    if (!served)
+        result.clear();
+    slot->shed = served ? 0 : 1;
+
+    // the response goes back in pieces of 'slotSize' bytes
+    //
+    size_t   offset   = 0;
+    uint32_t expected = slotServing;
+    while (true) {
+        size_t piece = std::min<size_t>(result.size() - offset,
+                                        header->slotSize);
+        std::memcpy(data, result.data() + offset, piece);
+        slot->length = piece;
+        offset      += piece;
+
+        bool last = offset == result.size();
+        if (!slot->state.compare_exchange_strong(
+                            expected, last ? slotResponse : slotResponseMore)) {
+            // the requester gave up
+            //
+            slot->state = slotFree;
+            return;
+        }
+        futexWake(&slot->state, 1);
+        if (last)
+            return;
+
+        // wait for the requester to take the piece
+        //
+        while (true) {
+            uint32_t state = slot->state.load();
+            if (slotContinue == state)
+                break;
+            if (slotAbandoned == state || 0 != header->stopping.load() ||
+                !alive(slot->pid)) {
+                slot->state = slotFree;
+                return;
+            }
+            futexWait(&slot->state, state, waitSliceMs);
+        }
+        expected = slotContinue;
+    }
+}
+
+std::shared_ptr<cc::ShmClient> cc::ShmClient::open(const std::string& segment)
+{
+    auto separator = segment.find(';');
+    if (separator == std::string::npos)
+        return nullptr;
+    std::string name  = segment.substr(0, separator);
+    uint64_t    nonce = std::strtoull(segment.c_str() + separator + 1,
+                                      nullptr, 10);
+
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat info;
+    void* base = MAP_FAILED;
+    if (0 == fstat(fd, &info) && (size_t)info.st_size >= headerSize())
+        base = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == base)
+        return nullptr;
+
+    Header* header = headerOf(base);
+    if (header->magic != shmMagic || header->version != shmVersion ||
+        header->nonce != nonce ||
+        (size_t)info.st_size < segmentSize(header->slots, header->slotSize)) {
+        munmap(base, info.st_size);
+        return nullptr;
+    }
+    return std::shared_ptr<ShmClient>(new ShmClient(base, info.st_size));
+}
+
+cc::ShmClient::ShmClient(void* base, size_t size)
+             : _base{base}
+             , _size{size}
+             , _next{0}
+{
+}
+
+cc::ShmClient::~ShmClient()
+{
+    munmap(_base, _size);
+}
+
+cc::ShmClient::Status
+cc::ShmClient::call(bool binary, int32_t cmdId, const char* cmd,
+                    const char* data, size_t length, unsigned timeoutMs,
+                    std::string& result)
+{
+    using namespace std::chrono;
+
+    Header* header = headerOf(_base);
+    if (!alive(header->pid) || 0 != header->stopping.load())
+        return gone;
+    if (length > header->slotSize || std::strlen(cmd) >= cmdSize)
+        return unsent;
+
+    // claim a free slot, requesters start at different slots;
+    // if none is free, take back one whose requester died
+    //
+    Slot*    slot  = nullptr;
+    uint32_t claim = slotClaimed | uint32_t(getpid());
+    unsigned first = _next.fetch_add(1, std::memory_order_relaxed);
+    for (unsigned i = 0; i < header->slots && nullptr == slot; ++i) {
+        Slot*    which    = slotOf(_base, (first + i) % header->slots);
+        uint32_t expected = slotFree;
+        if (which->state.compare_exchange_strong(expected, claim))
+            slot = which;
+    }
+    for (unsigned i = 0; i < header->slots && nullptr == slot; ++i) {
+        Slot*    which    = slotOf(_base, i);
+        uint32_t expected = which->state.load();
+        if (orphaned(expected, which) &&
+            which->state.compare_exchange_strong(expected, claim))
+            slot = which;
+    }
+    if (nullptr == slot)
+        return unsent;
+
+    slot->pid    = getpid();
+    slot->binary = binary ? 1 : 0;
+    slot->cmdId  = cmdId;
+    slot->length = length;
+    std::strcpy(slot->cmd, cmd);
+    std::memcpy(dataOf(slot), data, length);
+    slot->state = slotRequest;
+
+    header->doorbell.fetch_add(1);
+    futexWake(&header->doorbell, 1);
+
+    result.clear();
+    auto deadline = timeoutMs > 0 ?
+                    steady_clock::now() + milliseconds(timeoutMs) :
+                    steady_clock::time_point::max();
+    while (true) {
+        uint32_t state = slot->state.load();
+        if (slotResponseMore == state || slotResponse == state) {
+            result.append(dataOf(slot), slot->length);
+            if (slotResponse == state) {
+                bool shed   = 0 != slot->shed;
+                slot->state = slotFree;
+                return shed ? overloaded : done;
+            }
+            slot->state = slotContinue;
+            futexWake(&slot->state, 1);
+            continue;
+        }
+
+        auto now = steady_clock::now();
+        if (now >= deadline || !alive(header->pid) ||
+            0 != header->stopping.load()) {
+            // a request not picked up yet is simply taken back,
+            // otherwise the provider frees the slot
+            //
+            uint32_t next = slotRequest == state ? slotFree : slotAbandoned;
+            if (slot->state.compare_exchange_strong(state, next)) {
+                futexWake(&slot->state, 1);
+                result.clear();
+                return now >= deadline ? timedOut : gone;
+            }
+            continue;
+        }
+
+        auto left = duration_cast<milliseconds>(deadline - now).count();
+        futexWait(&slot->state, state,
+                  (unsigned)std::max<long long>(1,
+                            std::min<long long>(left, waitSliceMs)));
+    }
+}
+
+#else   // no shared memory transport, every request goes through CORBA
+
+std::unique_ptr<cc::ShmServer>
+cc::ShmServer::create(const std::string&, unsigned, unsigned, unsigned,
+                      Handler)
+{
+    return nullptr;
+}
+
+cc::ShmServer::~ShmServer()
+{
+}
+
+std::shared_ptr<cc::ShmClient> cc::ShmClient::open(const std::string&)
+{
+    return nullptr;
+}
+
+cc::ShmClient::~ShmClient()
+{
+}
+
+cc::ShmClient::Status
+cc::ShmClient::call(bool, int32_t, const char*, const char*, size_t,
+                    unsigned, std::string&)
+{
+    return unsent;
+}
+
+#endif
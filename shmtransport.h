@@ -0,0 +1,107 @@
+#ifndef _SHM_TRANSPORT_H
+#define _SHM_TRANSPORT_H
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+namespace cc {
+
+// same-host RPC through a shared memory segment (Linux only)
+//
+// a provider creates a segment of 'slots'; a requester claims a free
+// slot, writes the request in it and rings the segment's doorbell,
+// one of the provider's threads serves it and writes the response
+// back in the same slot, in pieces if it doesn't fit; both sides
+// sleep on futexes while they wait
+//
+// the segment is discovered through the provider's object reference
+// ('sharedMemory()' of the IDL), a requester on another host can't
+// open it, or finds a different nonce in it, and stays with CORBA
+//
+class ShmServer {
+public:
+    // false if the request is shed, the requester is told it's overloaded
+    //
+    typedef std::function<bool(bool binary, int32_t cmdId,
+                               const char* cmd,
+                               const char* data, size_t length,
+                               std::string& result)>
+            Handler;
+
+    // nullptr if shared memory isn't available
+    //
+    static std::unique_ptr<ShmServer> create(const std::string& hostId,
+                                             unsigned slots,
+                                             unsigned slotSize,
+                                             unsigned threads,
+                                             Handler  handler);
+    ~ShmServer();
+
+    // "name;nonce", what requesters need to open the segment
+    //
+    const std::string& segment() const { return _segment; }
+
+    // Big-5 rules
+    ShmServer() = delete;
+    ShmServer(const ShmServer&) = delete;
+    ShmServer(ShmServer&&) = delete;
+    ShmServer& operator=(const ShmServer&) = delete;
+    ShmServer& operator=(ShmServer&&) = delete;
+
+private:
+    ShmServer(const std::string& name, void* base, size_t size,
+              Handler handler);
+    void run();
+    void serve(unsigned slot);
+
+    std::string               _name;
+    std::string               _segment;
+    void*                     _base;
+    size_t                    _size;
+    Handler                   _handler;
+    std::vector<std::thread>  _workers;
+};
+
+class ShmClient {
+public:
+    enum Status {
+        done,
+        unsent,         // nothing was sent, use CORBA instead
+        timedOut,       // sent, but not answered within 'timeoutMs'
+        overloaded,     // the provider shed the request, it wasn't run
+        gone            // the provider died or is stopping
+    };
+
+    // nullptr if the segment can't be opened or isn't the provider's
+    //
+    static std::shared_ptr<ShmClient> open(const std::string& segment);
+    ~ShmClient();
+
+    // 0 'timeoutMs' waits as long as the provider is alive
+    //
+    Status call(bool binary, int32_t cmdId, const char* cmd,
+                const char* data, size_t length, unsigned timeoutMs,
+                std::string& result);
+
+    // Big-5 rules
+    ShmClient() = delete;
+    ShmClient(const ShmClient&) = delete;
+    ShmClient(ShmClient&&) = delete;
+    ShmClient& operator=(const ShmClient&) = delete;
+    ShmClient& operator=(ShmClient&&) = delete;
+
+private:
+    ShmClient(void* base, size_t size);
+
+    void*                  _base;
+    size_t                 _size;
+    std::atomic<unsigned>  _next;
+};
+
+};  // namespace cc
+
+#endif
@@ -0,0 +1,211 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <cstdlib>
+#include <corbaComm/corbaComm.h>
+#include "procs.h"
+
+// subscriptions churn while events flow: threads of the subscriber
+// subscribe and detach as fast as they can, on the topic a steady
+// subscriber listens to and on topics of their own, while a publisher
+// keeps publishing; run inline and with 'eventThreads'
+//
+// fails if the steady subscriber misses its events or gets them out
+// of order, or a callback is still called well after it's detached
+//
+//      churnStress [seconds] [ORB options]
+//
+
+static const unsigned churners = 8;
+static const char*    topic    = "churn";
+
+static std::atomic<uint64_t> steadyEvents{0};
+static std::atomic<uint64_t> outOfOrder{0};
+static std::atomic<uint64_t> lastSeq{0};
+static std::atomic<uint64_t> churnEvents[churners];
+
+static void steady(const std::string&, const std::string& data)
+{
+    uint64_t seq = std::strtoull(data.c_str(), nullptr, 10);
+    if (seq <= lastSeq.load())
+        ++outOfOrder;
+    lastSeq = seq;
+    ++steadyEvents;
+}
+
+template <int N>
+void counted(const std::string&, const std::string&)
+{
+    ++churnEvents[N];
+}
+
+template <int N>
+void countedBin(const std::string&, const char*, size_t)
+{
+    ++churnEvents[N];
+}
+
+template <int N>
+void countedBatch(const std::string&, const cc::EventViews& events)
+{
+    churnEvents[N] += events.size();
+}
+
+static const cc::EventCallback_t callbacks[churners] = {
+    &counted<0>, &counted<1>, &counted<2>, &counted<3>,
+    &counted<4>, &counted<5>, &counted<6>, &counted<7>
+};
+static const cc::BinaryEventCallback_t binCallbacks[churners] = {
+    &countedBin<0>, &countedBin<1>, &countedBin<2>, &countedBin<3>,
+    &countedBin<4>, &countedBin<5>, &countedBin<6>, &countedBin<7>
+};
+static const cc::EventBatchCallback_t batchCallbacks[churners] = {
+    &countedBatch<0>, &countedBatch<1>, &countedBatch<2>, &countedBatch<3>,
+    &countedBatch<4>, &countedBatch<5>, &countedBatch<6>, &countedBatch<7>
+};
+
+static std::string ownTopic(unsigned which)
+{
+    return std::string(topic) + "." + std::to_string(which);
+}
+
+static int publisher(int argc, char* argv[], tests::Signal& subscribed,
+                     unsigned seconds)
+{
+    cc::CorbaComm* comm =
+    cc::CorbaComm::connect("churnPublisher", { }, { }, argc, argv);
+    if (!subscribed.wait(10000)) {
+        delete comm;
+        return 1;
+    }
+
+    auto     until = std::chrono::steady_clock::now() +
+                     std::chrono::seconds(seconds);
+    uint64_t seq   = 0;
+    while (std::chrono::steady_clock::now() < until) {
+        std::string data = std::to_string(++seq);
+        comm->pushEvent(topic, data.c_str());
+        comm->pushEvent(ownTopic(seq % churners).c_str(), data.c_str());
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    delete comm;
+    return 0;
+}
+
+static void churn(cc::CorbaComm* comm, unsigned which,
+                  std::chrono::steady_clock::time_point until,
+                  std::atomic<uint64_t>& subscribed,
+                  std::atomic<uint64_t>& refused)
+{
+    const std::string own = ownTopic(which);
+    for (unsigned i = 0; std::chrono::steady_clock::now() < until; ++i) {
+        const char* on = i % 2 ? topic : own.c_str();
+        cc::SID     sid;
+        switch (i % 3) {
+        case 0:  sid = comm->onEvent(on, callbacks[which]);            break;
+        case 1:  sid = comm->onBinEvent(on, binCallbacks[which]);      break;
+        default: sid = comm->onEventBatch(on, batchCallbacks[which]);  break;
+        }
+        if (sid.empty()) {
+            ++refused;
+            continue;
+        }
+        ++subscribed;
+        std::this_thread::sleep_for(std::chrono::microseconds(rand() % 2000));
+        comm->detachEvent(sid);
+    }
+}
+
+static uint64_t churned()
+{
+    uint64_t total = 0;
+    for (const auto& events : churnEvents)
+        total += events.load();
+    return total;
+}
+
+static int subscriber(int argc, char* argv[], tests::Signal& subscribed,
+                      unsigned seconds, const cc::Options& options)
+{
+    cc::CorbaComm* comm =
+    cc::CorbaComm::connect("churnSubscriber", { }, { }, argc, argv, options);
+    if (comm->onEvent(topic, &steady).empty()) {
+        delete comm;
+        return 1;
+    }
+    subscribed.raise();
+
+    std::atomic<uint64_t>    subscriptions{0};
+    std::atomic<uint64_t>    refused{0};
+    std::vector<std::thread> threads;
+    auto until = std::chrono::steady_clock::now() +
+                 std::chrono::seconds(seconds);
+    for (unsigned i = 0; i < churners; ++i)
+        threads.emplace_back(churn, comm, i, until,
+                             std::ref(subscriptions), std::ref(refused));
+    for (auto& thread : threads)
+        thread.join();
+
+    // events published before a detach may still be delivered,
+    // after a while none may be
+    //
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    uint64_t settled = churned();
+    uint64_t before  = steadyEvents.load();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    uint64_t late    = churned() - settled;
+    bool     flowing = steadyEvents.load() > before;
+
+    std::cout << "  subscriptions " << subscriptions.load()
+              << ", refused " << refused.load()
+              << ", churned events " << settled
+              << ", steady events " << steadyEvents.load()
+              << ", out of order " << outOfOrder.load()
+              << ", after detach " << late << "\n";
+    delete comm;
+
+    bool passed = steadyEvents.load() > 0 && 0 == outOfOrder.load() &&
+                  0 == late && flowing;
+    return passed ? 0 : 1;
+}
+
+static int run(int argc, char* argv[], unsigned seconds,
+               const cc::Options& options)
+{
+    tests::Signal subscribed;
+
+    // the publisher outlasts the churn, so late deliveries show
+    //
+    pid_t sub = tests::spawn([&]() {
+        return subscriber(argc, argv, subscribed, seconds, options);
+    });
+    pid_t pub = tests::spawn([&]() {
+        return publisher(argc, argv, subscribed, seconds + 3);
+    });
+
+    int failed = tests::join(sub);
+    tests::stop(pub);
+    return failed;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned seconds = tests::leadingArg(argc, argv, 10);
+    int      failed  = 0;
+
+    cc::Options inline_;
+    std::cout << "on the ORB thread:\n";
+    failed |= run(argc, argv, seconds, inline_);
+
+    cc::Options threaded;
+    threaded.eventThreads     = 4;
+    threaded.consumeBatchSize = 32;
+    std::cout << "by 4 eventThreads, batches of 32:\n";
+    failed |= run(argc, argv, seconds, threaded);
+
+    std::cout << (failed ? "churnStress failed\n" : "churnStress passed\n");
+    return failed;
+}
@@ -0,0 +1,160 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <corbaComm/corbaComm.h>
+#include "procs.h"
+
+// compression's CPU/latency trade-off: a provider echoes payloads of
+// several sizes, under a command per compression policy (the
+// requester's per-command overrides), the requester reports the
+// latency and both sides' CPU time per call
+//
+// payloads are text-like, about as compressible as JSON; omniORB
+// refuses messages above its giopMaxMsgSize (2MB by default), pass
+// '-ORBgiopMaxMsgSize 33554432' for the 10MB payload
+//
+//      compressionBench [calls per MB] [ORB options]
+//
+
+struct Policy {
+    const char*          cmd;
+    cc::CompressionPolicy compression;
+};
+
+static const Policy policies[] = {
+    { "compressionBench.off",      { false,    0, 6 } },
+    { "compressionBench.level1",   { true,     0, 1 } },
+    { "compressionBench.level6",   { true,     0, 6 } },
+    { "compressionBench.level9",   { true,     0, 9 } },
+    { "compressionBench.adaptive", { true,  1024, 6 } }     // the default
+};
+static const char*  cpuCmd  = "compressionBench.cpu";
+static const size_t sizes[] = { 20, 1024, 64 * 1024, 1024 * 1024,
+                                10 * 1024 * 1024 };
+
+static std::string echo(const std::string&, const char* data, size_t length)
+{
+    return std::string(data, length);
+}
+
+static std::string cpu(const std::string&, const std::string&)
+{
+    return std::to_string(tests::cpuUs());
+}
+
+static std::string payload(size_t size)
+{
+    static const char* words[] = {
+        "\"id\":", "\"name\":", "\"value\":", "\"timestamp\":", "true,",
+        "false,", "null,", "{", "}", "[", "],", "sensor", "temperature",
+        "humidity", "\"ok\"", "\"error\""
+    };
+    std::string text;
+    text.reserve(size + 16);
+    while (text.size() < size) {
+        text += words[rand() % (sizeof words / sizeof words[0])];
+        text += std::to_string(rand() % 1000);
+    }
+    text.resize(size);
+    return text;
+}
+
+static int provider(int argc, char* argv[])
+{
+    cc::Commands offers = {cpuCmd};
+    for (const auto& policy : policies)
+        offers.push_back(policy.cmd);
+
+    cc::CorbaComm* comm =
+    cc::CorbaComm::connect("compressionProvider", offers, { }, argc, argv);
+    comm->onCmd(cpuCmd, &cpu);
+    for (const auto& policy : policies)
+        comm->onBinCmd(policy.cmd, &echo);
+    while (1)
+        std::this_thread::sleep_for(std::chrono::seconds(10));
+    return 0;
+}
+
+static int requester(int argc, char* argv[], unsigned callsPerMB)
+{
+    cc::Options  options;
+    cc::Commands wants = {cpuCmd};
+    options.cmdCompression[cpuCmd].enabled = false;
+    for (const auto& policy : policies) {
+        wants.push_back(policy.cmd);
+        options.cmdCompression[policy.cmd] = policy.compression;
+    }
+    cc::CorbaComm* comm =
+    cc::CorbaComm::connect("compressionRequester", { }, wants, argc, argv,
+                           options);
+
+    if (!tests::await([&]() { return !comm->execCmd(cpuCmd, "").empty(); },
+                      10000)) {
+        delete comm;
+        return 1;
+    }
+
+    std::cout << std::setw(10) << "bytes" << std::setw(12) << "policy"
+              << std::setw(14) << "latency us" << std::setw(16)
+              << "requester cpu" << std::setw(15) << "provider cpu\n";
+
+    int failed = 0;
+    for (size_t size : sizes) {
+        std::string data  = payload(size);
+        unsigned    calls = (unsigned)std::min<size_t>(2000,
+                            std::max<size_t>(3, callsPerMB *
+                                                (1024 * 1024) / size));
+        for (const auto& policy : policies) {
+            std::string result;
+            uint64_t providerCpu = std::strtoull(
+                     comm->execCmd(cpuCmd, "").c_str(), nullptr, 10);
+            uint64_t requesterCpu = tests::cpuUs();
+            uint64_t started      = tests::nowUs();
+            bool     done         = true;
+            for (unsigned i = 0; i < calls && done; ++i)
+                done = cc::CmdStatus::done ==
+                       comm->execBinCmd(policy.cmd, data.data(),
+                                        data.size(), result) &&
+                       result.size() == data.size();
+            uint64_t elapsedUs = tests::nowUs() - started;
+            requesterCpu = tests::cpuUs() - requesterCpu;
+            providerCpu  = std::strtoull(
+                           comm->execCmd(cpuCmd, "").c_str(), nullptr, 10) -
+                           providerCpu;
+
+            std::cout << std::setw(10) << size << std::setw(12)
+                      << (policy.cmd + std::strlen("compressionBench."));
+            // above 2MB, it's likely the ORB's message limit
+            //
+            if (!done) {
+                std::cout << "      failed\n";
+                if (size <= 1024 * 1024)
+                    failed = 1;
+                continue;
+            }
+            std::cout << std::setw(14) << elapsedUs / calls
+                      << std::setw(16) << requesterCpu / calls
+                      << std::setw(14) << providerCpu / calls << "\n";
+        }
+    }
+    delete comm;
+    return failed;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned callsPerMB = tests::leadingArg(argc, argv, 20);
+
+    pid_t prov = tests::spawn([&]() { return provider(argc, argv); });
+    pid_t req  = tests::spawn([&]() {
+        return requester(argc, argv, callsPerMB);
+    });
+    int failed = tests::join(req);
+    tests::stop(prov);
+    return failed;
+}
@@ -0,0 +1,149 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <cstring>
+#include <corbaComm/corbaComm.h>
+#include "procs.h"
+
+// event dispatch: a publisher sends a burst of events carrying their
+// publishing time, a subscriber with 1 or 8 callbacks on the topic
+// measures the rate and the latency to its first callback, inline and
+// by 'eventThreads', one event per call and in batches
+//
+//      dispatchBench [events] [ORB options]
+//
+
+static const char* topic    = "dispatchBench";
+static const size_t bodySize = 64;
+
+static std::vector<uint64_t>  latencies;
+static std::atomic<size_t>    received{0};
+
+static void timed(const std::string&, const char* data, size_t length)
+{
+    uint64_t sent;
+    if (length < sizeof sent)
+        return;
+    std::memcpy(&sent, data, sizeof sent);
+    size_t which = received.fetch_add(1);
+    if (which < latencies.size())
+        latencies[which] = tests::nowUs() - sent;
+}
+
+template <int N>
+void other(const std::string&, const char*, size_t)
+{
+}
+
+static const cc::BinaryEventCallback_t others[] = {
+    &other<1>, &other<2>, &other<3>, &other<4>,
+    &other<5>, &other<6>, &other<7>
+};
+
+struct Config {
+    unsigned callbacks;
+    unsigned eventThreads;
+    unsigned batchSize;
+};
+
+static int publisher(int argc, char* argv[], tests::Signal& subscribed,
+                     unsigned events, unsigned batchSize)
+{
+    cc::Options options;
+    options.eventBatchSize = batchSize;
+    cc::CorbaComm* comm =
+    cc::CorbaComm::connect("dispatchPublisher", { }, { }, argc, argv, options);
+    if (!subscribed.wait(10000)) {
+        delete comm;
+        return 1;
+    }
+
+    char body[bodySize] = { };
+    for (unsigned i = 0; i < events; ++i) {
+        uint64_t now = tests::nowUs();
+        std::memcpy(body, &now, sizeof now);
+        comm->pushBinEvent(topic, body, sizeof body);
+    }
+    comm->flushEvents();
+    delete comm;
+    return 0;
+}
+
+static int subscriber(int argc, char* argv[], tests::Signal& subscribed,
+                      unsigned events, const Config& config)
+{
+    cc::Options options;
+    options.eventThreads     = config.eventThreads;
+    options.consumeBatchSize = config.batchSize;
+    cc::CorbaComm* comm =
+    cc::CorbaComm::connect("dispatchSubscriber", { }, { }, argc, argv,
+                           options);
+
+    latencies.assign(events, 0);
+    comm->onBinEvent(topic, &timed);
+    for (unsigned i = 1; i < config.callbacks; ++i)
+        comm->onBinEvent(topic, others[i - 1]);
+    subscribed.raise();
+
+    // until every event is in, or none came for a while
+    //
+    uint64_t first = 0;
+    size_t   seen  = 0;
+    auto     idle  = std::chrono::steady_clock::now();
+    while (received.load() < events) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        size_t now = received.load();
+        if (now > 0 && 0 == first)
+            first = tests::nowUs();
+        if (now != seen) {
+            seen = now;
+            idle = std::chrono::steady_clock::now();
+        }
+        else if (std::chrono::steady_clock::now() - idle >
+                 std::chrono::seconds(5))
+            break;
+    }
+    uint64_t elapsedUs = tests::nowUs() - first;
+    size_t   got       = std::min<size_t>(received.load(), events);
+    latencies.resize(got);
+
+    std::cout << "  callbacks " << config.callbacks
+              << ", eventThreads " << config.eventThreads
+              << ", batch " << config.batchSize
+              << ": " << got << "/" << events << " events, "
+              << (elapsedUs ? got * 1000000 / elapsedUs : 0) << " events/s"
+              << ", latency p50 " << tests::percentile(latencies, 50)
+              << "us p99 " << tests::percentile(latencies, 99) << "us\n";
+    delete comm;
+    return got == events ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned events = tests::leadingArg(argc, argv, 100000);
+    const Config configs[] = {
+        { 1, 0,  1 },
+        { 8, 0,  1 },
+        { 8, 0, 64 },
+        { 8, 4,  1 },
+        { 8, 4, 64 }
+    };
+
+    int failed = 0;
+    for (const auto& config : configs) {
+        tests::Signal subscribed;
+        pid_t sub = tests::spawn([&]() {
+            return subscriber(argc, argv, subscribed, events, config);
+        });
+        pid_t pub = tests::spawn([&]() {
+            return publisher(argc, argv, subscribed, events,
+                             config.batchSize);
+        });
+        failed |= tests::join(sub);
+        tests::join(pub);
+    }
+    return failed;
+}
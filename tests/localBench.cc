@@ -0,0 +1,104 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <corbaComm/corbaComm.h>
+#include "procs.h"
+
+// local and remote invocation latency: the requester offers a command
+// itself (called directly, no ORB) and calls one of another process,
+// through CORBA and through shared memory, with a few payload sizes
+//
+//      localBench [calls] [ORB options]
+//
+
+static const char*  localCmd  = "localBench.local";
+static const char*  remoteCmd = "localBench.remote";
+static const size_t sizes[]   = { 20, 1024, 16 * 1024 };
+
+static std::string echo(const std::string&, const std::string& param)
+{
+    return param;
+}
+
+static int provider(int argc, char* argv[])
+{
+    cc::Options options;
+    options.sharedMemory = true;
+    cc::CorbaComm* comm =
+    cc::CorbaComm::connect("localBenchProvider", {remoteCmd}, { },
+                           argc, argv, options);
+    comm->onCmd(remoteCmd, &echo);
+    while (1)
+        std::this_thread::sleep_for(std::chrono::seconds(10));
+    return 0;
+}
+
+static bool measure(cc::CorbaComm* comm, const char* cmd, const char* path,
+                    size_t size, unsigned calls)
+{
+    std::string           param(size, 'x');
+    std::vector<uint64_t> latencies;
+    latencies.reserve(calls);
+
+    // the first call routes the command and connects
+    //
+    if (!tests::await([&]() { return comm->execCmd(cmd, param.c_str()) ==
+                                     param; }, 10000))
+        return false;
+    for (unsigned i = 0; i < calls; ++i) {
+        uint64_t started = tests::nowUs();
+        if (comm->execCmd(cmd, param.c_str()) != param)
+            return false;
+        latencies.push_back(tests::nowUs() - started);
+    }
+
+    std::cout << std::setw(8) << size << std::setw(15) << path
+              << std::setw(10) << tests::percentile(latencies, 50)
+              << std::setw(10) << tests::percentile(latencies, 99) << "\n";
+    return true;
+}
+
+static int requester(int argc, char* argv[], unsigned calls,
+                     bool sharedMemory)
+{
+    cc::Options options;
+    options.sharedMemory = sharedMemory;
+    cc::CorbaComm* comm =
+    cc::CorbaComm::connect("localBenchRequester", {localCmd},
+                           {localCmd, remoteCmd}, argc, argv, options);
+    comm->onCmd(localCmd, &echo);
+
+    bool done = true;
+    for (size_t size : sizes) {
+        if (sharedMemory)
+            done = measure(comm, remoteCmd, "shared memory", size, calls) &&
+                   done;
+        else
+            done = measure(comm, localCmd,  "local", size, calls) &&
+                   measure(comm, remoteCmd, "CORBA", size, calls) && done;
+    }
+    delete comm;
+    return done ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned calls = tests::leadingArg(argc, argv, 10000);
+
+    std::cout << std::setw(8) << "bytes" << std::setw(15) << "path"
+              << std::setw(10) << "p50 us" << std::setw(10) << "p99 us\n";
+
+    pid_t prov   = tests::spawn([&]() { return provider(argc, argv); });
+    int   failed = 0;
+    for (bool sharedMemory : { false, true }) {
+        pid_t req = tests::spawn([&]() {
+            return requester(argc, argv, calls, sharedMemory);
+        });
+        failed |= tests::join(req);
+    }
+    tests::stop(prov);
+    return failed;
+}
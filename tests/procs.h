@@ -0,0 +1,134 @@
+#ifndef _TESTS_PROCS_H
+#define _TESTS_PROCS_H
+#include <poll.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+// the stress tests and benchmarks need more than one host, and
+// 'CorbaComm::connect()' makes one host per process, so every host
+// runs in a child process; children are forked by a parent which
+// never connects, so no ORB thread is ever forked
+//
+// they need the naming service and the notification server running,
+// the same as the examples; ORB arguments are passed to every host
+//
+namespace tests {
+
+// 'host' runs in a child, the child's exit status is what it returns
+//
+inline pid_t spawn(const std::function<int()>& host)
+{
+    pid_t pid = fork();
+    if (0 == pid)
+        _exit(host());
+    return pid;
+}
+
+// the child's exit status, 1 if it was killed
+//
+inline int join(pid_t pid)
+{
+    int status = 0;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status))
+        return 1;
+    return WEXITSTATUS(status);
+}
+
+inline void stop(pid_t pid)
+{
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+}
+
+// a host tells its parent (or a sibling) it's ready, e.g. subscribed
+// create it before forking both sides
+//
+class Signal {
+public:
+    Signal()  { if (pipe(_fds) < 0) _fds[0] = _fds[1] = -1; }
+    ~Signal() { close(_fds[0]); close(_fds[1]); }
+
+    void raise() {
+        char c = 1;
+        if (write(_fds[1], &c, 1) < 0)
+            return;
+    }
+    bool wait(int timeoutMs) {
+        struct pollfd fd = { _fds[0], POLLIN, 0 };
+        char c;
+        return poll(&fd, 1, timeoutMs) > 0 && read(_fds[0], &c, 1) == 1;
+    }
+
+    Signal(const Signal&) = delete;
+    Signal& operator=(const Signal&) = delete;
+
+private:
+    int _fds[2];
+};
+
+// CLOCK_MONOTONIC is the same for every process of a host, so an event
+// can carry its publishing time to another process
+//
+inline uint64_t nowUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+// this process's CPU time, every thread's
+//
+inline uint64_t cpuUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return uint64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+// 'p' (0..100) percentile, 'samples' are sorted
+//
+inline uint64_t percentile(std::vector<uint64_t>& samples, double p)
+{
+    if (samples.empty())
+        return 0;
+    std::sort(samples.begin(), samples.end());
+    size_t which = (size_t)(p / 100 * (samples.size() - 1));
+    return samples[which];
+}
+
+// until 'ready()', e.g. a command of a provider which is still
+// starting up is routed; false if it isn't within 'timeoutMs'
+//
+inline bool await(const std::function<bool()>& ready, unsigned timeoutMs)
+{
+    for (unsigned waited = 0; !ready(); waited += 100) {
+        if (waited >= timeoutMs)
+            return false;
+        usleep(100 * 1000);
+    }
+    return true;
+}
+
+// a leading argument which isn't an ORB option, e.g. the seconds to run
+//
+inline unsigned leadingArg(int& argc, char* argv[], unsigned otherwise)
+{
+    if (argc < 2 || '-' == argv[1][0])
+        return otherwise;
+    unsigned value = (unsigned)std::strtoul(argv[1], nullptr, 10);
+    for (int i = 1; i < argc - 1; ++i)
+        argv[i] = argv[i + 1];
+    --argc;
+    return value;
+}
+
+};  // namespace tests
+
+#endif
@@ -0,0 +1,118 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <deque>
+#include <corbaComm/corbaComm.h>
+#include "procs.h"
+
+// command routing under churn: 32 threads of a requester call a
+// command as fast as they can, while its providers come and go, a new
+// one every 'churnMs', the oldest killed
+//
+// fails if a result isn't the request's, or no call gets through;
+// calls to a provider which is killed under them may fail
+//
+//      routingStress [seconds] [ORB options]
+//
+
+static const char*    cmd        = "routingStress";
+static const unsigned requesters = 32;
+static const unsigned providers  = 3;       // alive at a time
+static const unsigned churnMs    = 300;
+
+static std::string echo(const std::string&, const std::string& param)
+{
+    return param;
+}
+
+static int provider(int argc, char* argv[], unsigned which)
+{
+    std::string    hostId = "routingProvider" + std::to_string(which);
+    cc::CorbaComm* comm   =
+    cc::CorbaComm::connect(hostId.c_str(), {cmd}, { }, argc, argv);
+    comm->onCmd(cmd, &echo);
+    while (1)
+        std::this_thread::sleep_for(std::chrono::seconds(10));
+    return 0;
+}
+
+static int requester(int argc, char* argv[], unsigned seconds)
+{
+    cc::CorbaComm* comm =
+    cc::CorbaComm::connect("routingRequester", { }, {cmd}, argc, argv);
+
+    std::atomic<uint64_t>    answered{0};
+    std::atomic<uint64_t>    unanswered{0};
+    std::atomic<uint64_t>    wrong{0};
+    std::vector<std::thread> threads;
+    auto until = std::chrono::steady_clock::now() +
+                 std::chrono::seconds(seconds);
+    uint64_t started = tests::nowUs();
+    for (unsigned i = 0; i < requesters; ++i) {
+        threads.emplace_back([&, i]() {
+            for (uint64_t n = 0; std::chrono::steady_clock::now() < until;
+                 ++n) {
+                std::string param = std::to_string(i) + ":" +
+                                    std::to_string(n);
+                std::string result = comm->execCmd(cmd, param.c_str());
+                if (result.empty())
+                    ++unanswered;
+                else if (result != param)
+                    ++wrong;
+                else
+                    ++answered;
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    uint64_t elapsedUs = tests::nowUs() - started;
+
+    std::cout << requesters << " threads, " << seconds << "s: "
+              << answered.load() << " answered ("
+              << answered.load() * 1000000 / elapsedUs << " calls/s), "
+              << unanswered.load() << " unanswered, "
+              << wrong.load() << " wrong\n";
+    delete comm;
+    return answered.load() > 0 && 0 == wrong.load() ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned seconds = tests::leadingArg(argc, argv, 10);
+    unsigned spawned = 0;
+
+    std::deque<pid_t> alive;
+    for (; spawned < providers; ++spawned) {
+        unsigned which = spawned;
+        alive.push_back(tests::spawn([&]() {
+            return provider(argc, argv, which);
+        }));
+    }
+    pid_t req = tests::spawn([&]() {
+        return requester(argc, argv, seconds);
+    });
+
+    // replace the oldest provider until the requester is done
+    //
+    int status;
+    while (0 == waitpid(req, &status, WNOHANG)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(churnMs));
+        unsigned which = spawned++;
+        alive.push_back(tests::spawn([&]() {
+            return provider(argc, argv, which);
+        }));
+        tests::stop(alive.front());
+        alive.pop_front();
+    }
+    for (pid_t pid : alive)
+        tests::stop(pid);
+
+    bool failed = !WIFEXITED(status) || 0 != WEXITSTATUS(status);
+    std::cout << spawned << " providers started\n"
+              << (failed ? "routingStress failed\n" : "routingStress passed\n");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,94 @@
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <corbaComm/corbaComm.h>
+#include <corbaComm/typed.h>
+
+// typed execCmd() against a fake CorbaComm, no ORB is needed; a failed
+// command must never decode as a response, even an empty one
+//
+struct Temperature { double celsius; long timestamp; };
+
+struct ReadTemperature : cc::Command<cc::Void, Temperature> {
+    static const char* name() { return "readTemperature"; }
+};
+struct Reset : cc::Command<cc::Void, cc::Void> {
+    static const char* name() { return "reset"; }
+};
+struct Echo : cc::Command<std::string, std::string> {
+    static const char* name() { return "echo"; }
+};
+
+class FakeComm : public cc::CorbaComm {
+public:
+    using cc::CorbaComm::execBinCmd;
+    cc::CmdStatus execBinCmd(const char*, const void* data, size_t length,
+                             std::string& result) override {
+        result.clear();
+        if (cc::CmdStatus::done == status)
+            result = response.empty() ?
+                     std::string((const char*)data, length) : response;
+        return status;
+    }
+
+    cc::CmdStatus status = cc::CmdStatus::done;
+    std::string   response;
+};
+
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+{
+    if (!ok) {
+        std::cout << "FAILED: " << what << "\n";
+        ++failures;
+    }
+}
+
+int main()
+{
+    FakeComm comm;
+    cc::Void none;
+
+    const cc::CmdStatus failed[] = { cc::CmdStatus::unrouted,
+                                     cc::CmdStatus::overloaded,
+                                     cc::CmdStatus::failed };
+    for (auto status : failed) {
+        comm.status = status;
+        cc::Void    reset;
+        std::string echoed;
+        Temperature temperature;
+        check(!cc::execCmd<Reset>(comm, none, reset), 
+              "a failed Void command is done");
+        check(!cc::execCmd<Echo>(comm, "", echoed), 
+              "a failed string command is done");
+        check(!cc::execCmd<ReadTemperature>(comm, none, temperature),
+              "a failed struct command is done");
+    }
+
+    comm.status = cc::CmdStatus::done;
+    cc::Void    reset;
+    std::string echoed;
+    check(cc::execCmd<Reset>(comm, none, reset), 
+          "an empty Void response is refused");
+    check(cc::execCmd<Echo>(comm, "", echoed) && echoed.empty(),
+          "an empty string response is refused");
+    check(cc::execCmd<Echo>(comm, std::string("a\0b", 3), echoed) &&
+          echoed == std::string("a\0b", 3),
+          "a string response isn't binary-safe");
+
+    Temperature sent = { 21.5, 1234 };
+    Temperature temperature;
+    comm.response.assign((const char*)&sent, sizeof sent);
+    check(cc::execCmd<ReadTemperature>(comm, none, temperature) &&
+          temperature.celsius == sent.celsius &&
+          temperature.timestamp == sent.timestamp,
+          "a struct response isn't decoded");
+
+    comm.response = "short";
+    check(!cc::execCmd<ReadTemperature>(comm, none, temperature),
+          "a response of the wrong size is decoded");
+
+    std::cout << (failures ? "typedTest failed\n" : "typedTest passed\n");
+    return failures ? 1 : 0;
+}
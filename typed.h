@@ -0,0 +1,152 @@
+#ifndef _TYPED_H
+#define _TYPED_H
+#include <string>
+#include <cstring>
+#include <type_traits>
+#include "corbaComm.h"
+
+namespace cc {
+
+// typed commands and events, on top of the binary-safe methods
+//
+// a command or an event is described by a tag type, e.g.
+//
+//      struct ReadTemperature : cc::Command<cc::Void, Temperature> {
+//          static const char* name() { return "readTemperature"; }
+//      };
+//      struct TemperatureTopic : cc::Event<Temperature> {
+//          static const char* name() { return "temperature"; }
+//      };
+//
+// trivially copyable types go on the wire as they are in memory, no
+// text formatting and no parsing; both hosts must share byte order
+// and struct layout; other types need a 'Codec' specialization
+//
+template <typename Req, typename Resp>
+struct Command {
+    typedef Req  Request;
+    typedef Resp Response;
+};
+
+template <typename T>
+struct Event {
+    typedef T Type;
+};
+
+// for commands without a request or a response
+//
+struct Void { };
+
+template <typename T, typename Enable = void>
+struct Codec;
+
+template <typename T>
+struct Codec<T, std::enable_if_t<std::is_trivially_copyable<T>::value>> {
+    static const char* bytes(const T& value) {
+        return reinterpret_cast<const char*>(&value);
+    }
+    static size_t size(const T&) {
+        return std::is_empty<T>::value ? 0 : sizeof(T);
+    }
+    static bool decode(const char* data, size_t length, T& value) {
+        if (std::is_empty<T>::value)
+            return 0 == length;
+        if (length != sizeof(T))
+            return false;
+        std::memcpy(&value, data, sizeof(T));
+        return true;
+    }
+};
+
+template <>
+struct Codec<std::string> {
+    static const char* bytes(const std::string& value) {
+        return value.data();
+    }
+    static size_t size(const std::string& value) {
+        return value.size();
+    }
+    static bool decode(const char* data, size_t length, std::string& value) {
+        value.assign(data, length);
+        return true;
+    }
+};
+
+// the trampolines between the binary callbacks and typed handlers
+//
+template <typename Cmd,
+          typename Cmd::Response (*Handler)(const typename Cmd::Request&)>
+std::string typedCmdCallback(const std::string&,
+                             const char* data, size_t length)
+{
+    typedef Codec<typename Cmd::Request>  RequestCodec;
+    typedef Codec<typename Cmd::Response> ResponseCodec;
+
+    typename Cmd::Request request;
+    if (!RequestCodec::decode(data, length, request))
+        return "";
+
+    typename Cmd::Response response = Handler(request);
+    return std::string(ResponseCodec::bytes(response),
+                       ResponseCodec::size(response));
+}
+
+template <typename Evt, void (*Handler)(const typename Evt::Type&)>
+void typedEventCallback(const std::string&, const char* data, size_t length)
+{
+    typename Evt::Type value;
+    if (Codec<typename Evt::Type>::decode(data, length, value))
+        Handler(value);
+}
+
+// for requesters, false if the command isn't done (it can't be
+// routed, it's shed, or it fails), or the response isn't
+// a 'Cmd::Response'; an empty response is never taken for a failure
+//
+template <typename Cmd>
+bool execCmd(CorbaComm& comm, const typename Cmd::Request& request,
+             typename Cmd::Response& response)
+{
+    typedef Codec<typename Cmd::Request>  RequestCodec;
+    typedef Codec<typename Cmd::Response> ResponseCodec;
+
+    std::string result;
+    if (CmdStatus::done != comm.execBinCmd(Cmd::name(),
+                                           RequestCodec::bytes(request),
+                                           RequestCodec::size(request),
+                                           result))
+        return false;
+    return ResponseCodec::decode(result.data(), result.size(), response);
+}
+
+// for providers, e.g.
+//
+//      Temperature readTemperature(const cc::Void&);
+//      cc::onCmd<ReadTemperature, &readTemperature>(*comm);
+//
+template <typename Cmd,
+          typename Cmd::Response (*Handler)(const typename Cmd::Request&)>
+void onCmd(CorbaComm& comm)
+{
+    comm.onBinCmd(Cmd::name(), &typedCmdCallback<Cmd, Handler>);
+}
+
+// for publishers and subscribers
+//
+template <typename Evt>
+bool pushEvent(CorbaComm& comm, const typename Evt::Type& value)
+{
+    typedef Codec<typename Evt::Type> TypeCodec;
+    return comm.pushBinEvent(Evt::name(), TypeCodec::bytes(value),
+                             TypeCodec::size(value));
+}
+
+template <typename Evt, void (*Handler)(const typename Evt::Type&)>
+SID onEvent(CorbaComm& comm)
+{
+    return comm.onBinEvent(Evt::name(), &typedEventCallback<Evt, Handler>);
+}
+
+};  // namespace cc
+
+#endif